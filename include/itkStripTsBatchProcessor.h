@@ -0,0 +1,213 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsBatchProcessor_h
+#define itkStripTsBatchProcessor_h
+
+#include "itkMultiThreaderBase.h"
+#include "itkObject.h"
+#include "itkStripTsImageFilter.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class StripTsBatchProcessor
+ * \brief skull-strips many patient images against one atlas
+ *
+ * Runs StripTsImageFilter for every patient image added with
+ * AddPatientImage(), several subjects at a time. Many stages of the
+ * filter do not scale beyond a few threads, so on large machines it is
+ * faster to run subjects side by side than to give all threads to one.
+ *
+ * The thread budget (SetThreadBudget(), defaults to the global default
+ * number of threads of ITK) is split into groups of ThreadsPerSubject
+ * work units; one subject is processed per group. The budget is nominal:
+ * the work units of all subjects run on the one global thread pool of
+ * ITK, so it only decides how the work units are divided and is limited
+ * to GetGlobalDefaultNumberOfThreads() (see GetUsableThreadBudget()).
+ * Each subject running side by side also keeps one thread of its own
+ * for the serial parts of the filter. The atlas is
+ * prepared once, either passed with SetPreparedAtlas() or computed from
+ * SetAtlasImage() and SetAtlasBrainMask() on the first Update().
+ * TWorkingTypes selects the internal pixel types of the filter, see
+ * StripTsImageFilter.
+ *
+ * An exception thrown while processing one subject is recorded for that
+ * subject only, the remaining subjects are processed regardless. Check
+ * GetSubjectSucceeded() before using GetOutput().
+ *
+ * The subjects share one process, so the CPU times and sampled memory in
+ * the stage metrics of the filter include all subjects running at the
+ * same time. Profile with a thread budget of ThreadsPerSubject, which
+ * processes one subject at a time.
+ *
+ * \ingroup SkullStrip
+ */
+
+template <typename TImageType,
+          typename TAtlasImageType,
+          typename TAtlasLabelType = Image<unsigned char, TAtlasImageType::ImageDimension>,
+          typename TWorkingTypes = StripTsWorkingTypes<TImageType, TAtlasImageType>>
+class ITK_TEMPLATE_EXPORT StripTsBatchProcessor : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(StripTsBatchProcessor);
+
+  // standard class type alias
+  using Self = StripTsBatchProcessor;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  // method for creation through the object factory
+  itkNewMacro(Self);
+
+  // run-time type information (and related methods)
+  itkTypeMacro(StripTsBatchProcessor, Object);
+
+  // display
+  void
+  PrintSelf(std::ostream & os, Indent indent) const override;
+
+  // image and label templates
+  using ImageType = TImageType;
+  using ImageConstPointer = typename ImageType::ConstPointer;
+
+  using AtlasImageType = TAtlasImageType;
+  using AtlasImageConstPointer = typename AtlasImageType::ConstPointer;
+
+  using AtlasLabelType = TAtlasLabelType;
+  using AtlasLabelPointer = typename AtlasLabelType::Pointer;
+  using AtlasLabelConstPointer = typename AtlasLabelType::ConstPointer;
+
+  using StripTsFilterType = StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>;
+  using PreparedAtlasType = typename StripTsFilterType::PreparedAtlasType;
+  using PreparedAtlasConstPointer = typename PreparedAtlasType::ConstPointer;
+
+  void
+  SetAtlasImage(const TAtlasImageType * ptr);
+  void
+  SetAtlasBrainMask(const TAtlasLabelType * ptr);
+
+  // atlas preprocessed once, takes precedence over atlas image and brain mask
+  itkSetConstObjectMacro(PreparedAtlas, PreparedAtlasType);
+  itkGetConstObjectMacro(PreparedAtlas, PreparedAtlasType);
+
+  // patient images, processed in the order they were added
+  void
+  AddPatientImage(const TImageType * ptr);
+  void
+  ClearPatientImages();
+  SizeValueType
+  GetNumberOfSubjects() const
+  {
+    return static_cast<SizeValueType>(m_PatientImages.size());
+  }
+
+  // total number of threads shared by all subjects running side by side
+  itkSetClampMacro(ThreadBudget, ThreadIdType, 1, NumericTraits<ThreadIdType>::max());
+  itkGetConstMacro(ThreadBudget, ThreadIdType);
+
+  // number of work units given to each subject
+  itkSetClampMacro(ThreadsPerSubject, ThreadIdType, 1, NumericTraits<ThreadIdType>::max());
+  itkGetConstMacro(ThreadsPerSubject, ThreadIdType);
+
+  // thread budget limited to the global thread pool, which runs the work units of all subjects
+  ThreadIdType
+  GetUsableThreadBudget() const
+  {
+    return std::min(m_ThreadBudget, MultiThreaderBase::GetGlobalDefaultNumberOfThreads());
+  }
+
+  // work units actually given to each subject, ThreadsPerSubject limited to the usable thread budget
+  ThreadIdType
+  GetWorkUnitsPerSubject() const
+  {
+    return std::min(m_ThreadsPerSubject, this->GetUsableThreadBudget());
+  }
+
+  // number of subjects processed side by side for the current settings
+  unsigned int
+  GetNumberOfConcurrentSubjects() const;
+
+  // strip all subjects
+  void
+  Update();
+
+  // per-subject results, valid after Update()
+  const AtlasLabelType *
+  GetOutput(SizeValueType subject) const;
+  bool
+  GetSubjectSucceeded(SizeValueType subject) const;
+  const std::string &
+  GetSubjectErrorMessage(SizeValueType subject) const;
+  double
+  GetSubjectTime(SizeValueType subject) const;
+
+  SizeValueType
+  GetNumberOfSucceededSubjects() const;
+
+  // wall time of the last Update() in seconds
+  itkGetConstMacro(ElapsedTime, double);
+
+  // successfully stripped subjects per hour of wall time in the last Update()
+  double
+  GetSubjectsPerHour() const;
+
+protected:
+  StripTsBatchProcessor();
+  ~StripTsBatchProcessor() override = default;
+
+private:
+  void
+  ProcessSubject(SizeValueType subject);
+
+  AtlasImageConstPointer         m_AtlasImage;
+  AtlasLabelConstPointer         m_AtlasLabels;
+  PreparedAtlasConstPointer      m_PreparedAtlas;
+  std::vector<ImageConstPointer> m_PatientImages;
+
+  ThreadIdType m_ThreadBudget;
+  ThreadIdType m_ThreadsPerSubject{ 4 };
+
+  // one entry per subject, each written only by the thread processing it
+  struct SubjectResult
+  {
+    AtlasLabelPointer Output;
+    bool              Succeeded{ false };
+    std::string       ErrorMessage;
+    double            Time{ 0.0 };
+  };
+
+  std::vector<SubjectResult> m_Results;
+  double                     m_ElapsedTime{ 0.0 };
+
+}; // end of class
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#  include "itkStripTsBatchProcessor.hxx"
+#endif
+
+#endif
@@ -0,0 +1,281 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsBatchProcessor_hxx
+#define itkStripTsBatchProcessor_hxx
+
+#include "itkMultiThreaderBase.h"
+#include "itkTimeProbe.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace itk
+{
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::StripTsBatchProcessor()
+{
+  // constructor
+  m_ThreadBudget = MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::PrintSelf(
+  std::ostream & os,
+  Indent         indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  itkPrintSelfObjectMacro(PreparedAtlas);
+  os << indent << "Number of subjects: " << this->GetNumberOfSubjects() << std::endl;
+  os << indent << "ThreadBudget: " << m_ThreadBudget << std::endl;
+  os << indent << "ThreadsPerSubject: " << m_ThreadsPerSubject << std::endl;
+  os << indent << "ElapsedTime: " << m_ElapsedTime << std::endl;
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::SetAtlasImage(
+  const TAtlasImageType * ptr)
+{
+  m_AtlasImage = ptr;
+  m_PreparedAtlas = nullptr;
+  this->Modified();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::SetAtlasBrainMask(
+  const TAtlasLabelType * ptr)
+{
+  m_AtlasLabels = ptr;
+  m_PreparedAtlas = nullptr;
+  this->Modified();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::AddPatientImage(
+  const TImageType * ptr)
+{
+  m_PatientImages.push_back(ptr);
+  this->Modified();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::ClearPatientImages()
+{
+  m_PatientImages.clear();
+  m_Results.clear();
+  this->Modified();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+unsigned int
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::
+  GetNumberOfConcurrentSubjects() const
+{
+  unsigned int concurrentSubjects =
+    std::max<unsigned int>(1, this->GetUsableThreadBudget() / this->GetWorkUnitsPerSubject());
+  if (!m_PatientImages.empty())
+  {
+    concurrentSubjects = std::min<unsigned int>(concurrentSubjects, m_PatientImages.size());
+  }
+  return concurrentSubjects;
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::Update()
+{
+  // prepare the atlas once for all subjects
+  if (m_PreparedAtlas.IsNull())
+  {
+    typename PreparedAtlasType::Pointer preparedAtlas = PreparedAtlasType::New();
+    preparedAtlas->SetAtlasImage(m_AtlasImage);
+    preparedAtlas->SetAtlasBrainMask(m_AtlasLabels);
+    preparedAtlas->Prepare();
+    m_PreparedAtlas = preparedAtlas;
+  }
+
+  const SizeValueType numberOfSubjects = this->GetNumberOfSubjects();
+  m_Results.clear();
+  m_Results.resize(numberOfSubjects);
+
+  // each worker picks the next unprocessed subject until all are done
+  std::atomic<SizeValueType> nextSubject{ 0 };
+  auto                       worker = [this, &nextSubject, numberOfSubjects]() {
+    for (SizeValueType subject = nextSubject++; subject < numberOfSubjects; subject = nextSubject++)
+    {
+      this->ProcessSubject(subject);
+    }
+  };
+
+  TimeProbe probe;
+  probe.Start();
+
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < this->GetNumberOfConcurrentSubjects(); ++i)
+  {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto & thread : workers)
+  {
+    thread.join();
+  }
+
+  probe.Stop();
+  m_ElapsedTime = probe.GetTotal();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::ProcessSubject(
+  SizeValueType subject)
+{
+  SubjectResult & result = m_Results[subject];
+
+  TimeProbe probe;
+  probe.Start();
+
+  // nothing may escape a worker thread, any failure is kept with its subject
+  try
+  {
+    if (m_PatientImages[subject].IsNull())
+    {
+      itkExceptionMacro(<< "Patient image of subject " << subject << " is not set");
+    }
+
+    typename StripTsFilterType::Pointer stripTsFilter = StripTsFilterType::New();
+    stripTsFilter->SetNumberOfWorkUnits(this->GetWorkUnitsPerSubject());
+    stripTsFilter->SetInput(m_PatientImages[subject]);
+    stripTsFilter->SetPreparedAtlas(m_PreparedAtlas);
+    stripTsFilter->Update();
+
+    result.Output = stripTsFilter->GetOutput();
+    result.Output->DisconnectPipeline();
+    result.Succeeded = true;
+  }
+  catch (itk::ExceptionObject & exception)
+  {
+    result.ErrorMessage = exception.what();
+  }
+  catch (std::exception & exception)
+  {
+    result.ErrorMessage = exception.what();
+  }
+  catch (...)
+  {
+    result.ErrorMessage = "Unknown exception";
+  }
+
+  probe.Stop();
+  result.Time = probe.GetTotal();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+auto
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::GetOutput(
+  SizeValueType subject) const
+  -> const AtlasLabelType *
+{
+  if (subject >= m_Results.size())
+  {
+    itkExceptionMacro(<< "No result for subject " << subject);
+  }
+  return m_Results[subject].Output.GetPointer();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+bool
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::GetSubjectSucceeded(
+  SizeValueType subject) const
+{
+  if (subject >= m_Results.size())
+  {
+    itkExceptionMacro(<< "No result for subject " << subject);
+  }
+  return m_Results[subject].Succeeded;
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+const std::string &
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::GetSubjectErrorMessage(
+  SizeValueType subject) const
+{
+  if (subject >= m_Results.size())
+  {
+    itkExceptionMacro(<< "No result for subject " << subject);
+  }
+  return m_Results[subject].ErrorMessage;
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+double
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::GetSubjectTime(
+  SizeValueType subject) const
+{
+  if (subject >= m_Results.size())
+  {
+    itkExceptionMacro(<< "No result for subject " << subject);
+  }
+  return m_Results[subject].Time;
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+SizeValueType
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::GetNumberOfSucceededSubjects() const
+{
+  return static_cast<SizeValueType>(std::count_if(
+    m_Results.begin(), m_Results.end(), [](const SubjectResult & result) { return result.Succeeded; }));
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+double
+StripTsBatchProcessor<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::GetSubjectsPerHour() const
+{
+  if (m_ElapsedTime <= 0.0)
+  {
+    return 0.0;
+  }
+  return 3600.0 * this->GetNumberOfSucceededSubjects() / m_ElapsedTime;
+}
+
+} // end namespace itk
+
+#endif
@@ -22,7 +22,6 @@
 
 #include "itkImageToImageFilter.h"
 
-#include "itkImageDuplicator.h"
 #include "itkRescaleIntensityImageFilter.h"
 
 #include "itkMultiResolutionImageRegistrationMethod.h"
@@ -35,20 +34,38 @@
 #include "itkVersorRigid3DTransformOptimizer.h"
 #include "itkRegularStepGradientDescentOptimizer.h"
 #include "itkMattesMutualInformationImageToImageMetric.h"
+#include "itkImageRegistrationMethodv4.h"
+#include "itkMattesMutualInformationImageToImageMetricv4.h"
+#include "itkRegularStepGradientDescentOptimizerv4.h"
+#include "itkRegistrationParameterScalesFromPhysicalShift.h"
+#include "itkImageMaskSpatialObject.h"
 
 #include "itkBinaryBallStructuringElement.h"
 #include "itkBinaryErodeImageFilter.h"
+#include "itkSignedMaurerDistanceMapImageFilter.h"
+#include "itkAddImageFilter.h"
 
 #include "itkBinaryThresholdImageFilter.h"
 #include "itkGradientAnisotropicDiffusionImageFilter.h"
 #include "itkGradientMagnitudeRecursiveGaussianImageFilter.h"
-#include "itkSigmoidImageFilter.h"
+#include "itkStripTsSigmoidFeatureImageFilter.h"
 #include "itkGeodesicActiveContourLevelSetImageFilter.h"
+#include "itkStripTsNarrowBandGeodesicActiveContourLevelSetImageFilter.h"
 #include "itkCastImageFilter.h"
 
 #include "itkTimeProbesCollectorBase.h"
+#include "itkTimeProbe.h"
+#include "itkMemoryUsageObserver.h"
 #include "itkProgressAccumulator.h"
 
+#include "itkStripTsPreparedAtlas.h"
+#include "itkStripTsStageMetrics.h"
+#include "itkStripTsWorkingTypes.h"
+
+#include <ctime>
+
+#include <vector>
+
 namespace itk
 {
 
@@ -63,6 +80,90 @@ namespace itk
  * SetAtlasBrainMask()
  * and it outputs the brain mask for the patient image
  *
+ * A failure in any stage aborts the run: Update() throws an
+ * ExceptionObject naming the stage, nothing is printed.
+ *
+ * Instead of SetAtlasImage() and SetAtlasBrainMask() a StripTsPreparedAtlas
+ * can be passed with SetPreparedAtlas(). This skips rescaling the atlas,
+ * building its registration pyramid and binarizing its mask on every run,
+ * which pays off when many patients are stripped with the same atlas.
+ *
+ * The atlas is aligned with a rigid and then an affine registration. By
+ * default the affine transform is initialized with the rigid one, the
+ * affine stage registers the original atlas (reusing its prepared
+ * pyramid) and the atlas mask is interpolated only once, with the final
+ * transform. ComposeRegistrationTransformsOff() restores the staged
+ * registration of earlier versions: the rigid result is resampled onto
+ * the patient image and the affine stage registers that resampled atlas.
+ *
+ * UseRegistrationv4On() runs both registration stages with the
+ * multithreaded ImageRegistrationMethodv4 and the v4 Mattes mutual
+ * information metric instead of the legacy framework. The metric is
+ * sampled with MetricSamplingStrategy (random by default) on
+ * MetricSamplingPercentage of the voxels, restricted to the head (patient
+ * voxels of at least HeadMaskThreshold after rescaling to 0-255) unless
+ * UseHeadMaskOff(). Parameter scales are estimated from physical shifts.
+ *
+ * The brain mask is refined with a geodesic active contour at 2mm and
+ * at 1mm isotropic resolution. By default it is solved with the sparse
+ * field solver of GeodesicActiveContourLevelSetImageFilter, which runs
+ * in a single thread. UseNarrowBandLevelSetOn() switches to the
+ * multithreaded StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter
+ * with the same weights. The masks of both solvers are not identical;
+ * itkStripTsImageFilterBenchmark reports the level set time of both.
+ *
+ * With CropToBrainRegionOn() the resampling, smoothing and level set
+ * stages only process the bounding box of the registered atlas mask,
+ * enlarged by BrainRegionMargin (in mm, 25 by default). Neck, shoulders
+ * and air of large field of view scans are skipped; the output still
+ * covers the whole input. The margin should include the scalp, since the
+ * feature image of the level set is normalized within the region.
+ *
+ * LowMemoryModeOn() releases the intermediate images of the level set as
+ * soon as they have been consumed, and the patient image and mask of
+ * each resolution before the level set is solved. When the 1mm
+ * resolution is allocated, only the 2mm mask or level set seeding it is
+ * left; buffers are not reused across resolutions, their grids differ.
+ * It does not change the segmentation; combine it with
+ * CropToBrainRegionOn() to bound the memory use on large scans. The
+ * memory use of the process is sampled at the start and end of each
+ * stage and between its internal filters; the largest sample of each
+ * stage is its SampledPeakMemory in GetStageMetrics() and is listed by
+ * GetMemoryReport(). Allocations freed between two samples are missed,
+ * so these values are lower bounds of the true peak.
+ *
+ * GetStageMetrics() returns the wall and CPU time, work units, sampled
+ * peak memory and voxel count of every stage of the last run, plus
+ * iterations and final metric values per level of the registrations and
+ * iterations and RMS change per resolution of the level set. GetMetricsAsJSON()
+ * exports the same values. A StripTsStageEndEvent is invoked after each
+ * stage, so observers can record the metrics while the filter runs.
+ * GetTimerReport() still returns the formatted timings.
+ *
+ * The feature image of the level set is computed by smoothing, gradient
+ * magnitude and a single pass doing rescaling and sigmoid mapping in
+ * place (StripTsSigmoidFeatureImageFilter). The largest increase in
+ * memory use sampled after each of these filters is reported by
+ * GetFeatureImageSampledPeakMemory().
+ *
+ * The pixel types of the internal stages are set by TWorkingTypes. The
+ * default StripTsWorkingTypes registers in the pixel types of the patient
+ * and atlas images. StripTsCompactWorkingTypes registers and resamples
+ * the images rescaled to 0-255 as unsigned char, which moves a quarter of
+ * the bytes of int or float images; only the feature image and the level
+ * set are float. The patient image resampled for the level set keeps its
+ * own pixel type in both cases.
+ *
+ * By default the registered atlas mask is eroded with a ball of radius 3
+ * voxels and cast to float to seed the level set.
+ * UseDistanceMapErosionOn() instead computes the signed distance map of
+ * the mask in linear time and shifts it by ErosionRadius (in mm, 3 by
+ * default). Its positive part is the eroded mask; no binary image of it is
+ * built, the map itself, linearly resampled to 2mm, seeds the level set as
+ * a signed distance function with iso value 0. The level set of the 2mm
+ * resolution then seeds the 1mm resolution directly. Metrics and timers
+ * name this stage DistanceMapErosion instead of BinaryErosion.
+ *
  * \warning images have to be 3D
  *
  *
@@ -92,7 +193,8 @@ namespace itk
 
 template <typename TImageType,
           typename TAtlasImageType,
-          typename TAtlasLabelType = Image<unsigned char, TAtlasImageType::ImageDimension>>
+          typename TAtlasLabelType = Image<unsigned char, TAtlasImageType::ImageDimension>,
+          typename TWorkingTypes = StripTsWorkingTypes<TImageType, TAtlasImageType>>
 class ITK_TEMPLATE_EXPORT StripTsImageFilter : public ImageToImageFilter<TImageType, TAtlasLabelType>
 {
 public:
@@ -127,13 +229,102 @@ public:
   using AtlasLabelPointer = typename AtlasLabelType::Pointer;
   using AtlasLabelConstPointer = typename AtlasLabelType::ConstPointer;
 
+  // pixel types of the internal stages
+  using WorkingTypes = TWorkingTypes;
+  using RegistrationImageType = typename WorkingTypes::RegistrationImageType;
+  using AtlasRegistrationImageType = typename WorkingTypes::AtlasRegistrationImageType;
+  using LevelSetImageType = typename WorkingTypes::LevelSetImageType;
+
   using ProgressPointer = typename ProgressAccumulator::Pointer;
+  using PointType = typename ImageType::PointType;
+  using MemoryLoadType = MemoryUsageObserver::MemoryLoadType;
+  using MetricSamplingStrategyEnum = ImageRegistrationMethodv4Enums::MetricSamplingStrategy;
+  using StageMetricsType = StripTsStageMetrics;
+
+  using PreparedAtlasType = StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, AtlasRegistrationImageType>;
+  using PreparedAtlasConstPointer = typename PreparedAtlasType::ConstPointer;
 
   void
   SetAtlasImage(const TAtlasImageType * ptr);
   void
   SetAtlasBrainMask(const TAtlasLabelType * ptr);
 
+  // atlas preprocessed once, takes precedence over atlas image and brain mask
+  itkSetConstObjectMacro(PreparedAtlas, PreparedAtlasType);
+  itkGetConstObjectMacro(PreparedAtlas, PreparedAtlasType);
+
+  // solve the level set on a multithreaded narrow band instead of the sparse field
+  itkSetMacro(UseNarrowBandLevelSet, bool);
+  itkGetConstMacro(UseNarrowBandLevelSet, bool);
+  itkBooleanMacro(UseNarrowBandLevelSet);
+
+  // register with the ITKv4 framework instead of the legacy one
+  itkSetMacro(UseRegistrationv4, bool);
+  itkGetConstMacro(UseRegistrationv4, bool);
+  itkBooleanMacro(UseRegistrationv4);
+
+  // metric sampling of the ITKv4 registration
+  itkSetEnumMacro(MetricSamplingStrategy, MetricSamplingStrategyEnum);
+  itkGetEnumMacro(MetricSamplingStrategy, MetricSamplingStrategyEnum);
+  itkSetClampMacro(MetricSamplingPercentage, double, 0.0, 1.0);
+  itkGetConstMacro(MetricSamplingPercentage, double);
+
+  // restrict the ITKv4 metric to voxels of the rescaled patient image above HeadMaskThreshold
+  itkSetMacro(UseHeadMask, bool);
+  itkGetConstMacro(UseHeadMask, bool);
+  itkBooleanMacro(UseHeadMask);
+  itkSetMacro(HeadMaskThreshold, double);
+  itkGetConstMacro(HeadMaskThreshold, double);
+
+  // start the affine registration from the rigid result and resample the atlas mask only once, on by default
+  itkSetMacro(ComposeRegistrationTransforms, bool);
+  itkGetConstMacro(ComposeRegistrationTransforms, bool);
+  itkBooleanMacro(ComposeRegistrationTransforms);
+
+  // restrict the level set refinement to the registered brain region
+  itkSetMacro(CropToBrainRegion, bool);
+  itkGetConstMacro(CropToBrainRegion, bool);
+  itkBooleanMacro(CropToBrainRegion);
+
+  // margin around the registered brain mask in mm, negative values are clamped to 0
+  itkSetClampMacro(BrainRegionMargin, double, 0.0, NumericTraits<double>::max());
+  itkGetConstMacro(BrainRegionMargin, double);
+
+  // erode by shifting a signed distance map and seed the level set with it
+  itkSetMacro(UseDistanceMapErosion, bool);
+  itkGetConstMacro(UseDistanceMapErosion, bool);
+  itkBooleanMacro(UseDistanceMapErosion);
+
+  // erosion depth of the distance map erosion in mm, negative values are clamped to 0
+  itkSetClampMacro(ErosionRadius, double, 0.0, NumericTraits<double>::max());
+  itkGetConstMacro(ErosionRadius, double);
+
+  // release level set intermediates early, independent of CropToBrainRegion
+  itkSetMacro(LowMemoryMode, bool);
+  itkGetConstMacro(LowMemoryMode, bool);
+  itkBooleanMacro(LowMemoryMode);
+
+  const std::string &
+  GetMemoryReport() const
+  {
+    return m_MemoryReport;
+  }
+
+  // largest sampled increase in process memory while computing the feature image of the last run, in kB
+  itkGetConstMacro(FeatureImageSampledPeakMemory, MemoryLoadType);
+
+#if !defined(ITK_WRAPPING_PARSER)
+  // metrics of each stage of the last run, in execution order; not wrapped, use GetMetricsAsJSON()
+  const std::vector<StageMetricsType> &
+  GetStageMetrics() const
+  {
+    return m_StageMetrics;
+  }
+#endif
+
+  std::string
+  GetMetricsAsJSON() const;
+
   const std::string &
   GetTimerReport() const
   {
@@ -150,12 +341,65 @@ protected:
 
 
 private:
-  ImagePointer            m_PatientImage;
-  AtlasImagePointer       m_AtlasImage;
-  AtlasLabelPointer       m_AtlasLabels;
-  ProgressPointer         m_Progress;
-  TimeProbesCollectorBase m_Timer;
-  std::string             m_TimerReport;
+  using RegistrationImagePointer = typename RegistrationImageType::Pointer;
+  using AtlasRegistrationImagePointer = typename AtlasRegistrationImageType::Pointer;
+  using LevelSetImagePointer = typename LevelSetImageType::Pointer;
+  using LevelSetPixelType = typename LevelSetImageType::PixelType;
+  using TransformBaseType = Transform<double, 3, 3>;
+  using RigidTransformType = VersorRigid3DTransform<double>;
+  using RigidTransformPointer = typename RigidTransformType::Pointer;
+  using AffineTransformType = AffineTransform<double, 3>;
+
+  ImagePointer                  m_PatientImage;
+  RegistrationImagePointer      m_RegistrationImage;
+  AtlasImageConstPointer        m_InputAtlasImage;
+  AtlasLabelConstPointer        m_InputAtlasLabels;
+  AtlasRegistrationImagePointer m_AtlasImage;
+  AtlasLabelPointer             m_AtlasLabels;
+  LevelSetImagePointer          m_LevelSet;
+  PreparedAtlasConstPointer     m_PreparedAtlas;
+  PreparedAtlasConstPointer     m_AtlasInUse;
+  ProgressPointer               m_Progress;
+  TimeProbesCollectorBase       m_Timer;
+  std::string                   m_TimerReport;
+  MemoryUsageObserver           m_MemoryObserver;
+  StageMetricsType              m_CurrentStage;
+  std::vector<StageMetricsType> m_StageMetrics;
+  TimeProbe                     m_StageProbe;
+  std::clock_t                  m_StageClock;
+  std::string                   m_MemoryReport;
+  RigidTransformPointer         m_RigidTransform;
+  bool                          m_UseRegistrationv4;
+  MetricSamplingStrategyEnum    m_MetricSamplingStrategy;
+  double                        m_MetricSamplingPercentage;
+  bool                          m_UseHeadMask;
+  double                        m_HeadMaskThreshold;
+  bool                          m_ComposeRegistrationTransforms;
+  bool                          m_UseNarrowBandLevelSet;
+  bool                          m_UseDistanceMapErosion;
+  double                        m_ErosionRadius;
+  bool                          m_CropToBrainRegion;
+  bool                          m_LowMemoryMode;
+  double                        m_BrainRegionMargin;
+  PointType                     m_BrainRegionOrigin;
+  Vector<double, 3>             m_BrainRegionExtent;
+  MemoryLoadType                m_FeatureImageSampledPeakMemory;
+
+  void
+  ConfigureInternalFilter(ProcessObject * filter) const;
+
+  // timing and memory bookkeeping of the top level stages
+  void
+  StartStage(const std::string & stage);
+  void
+  StopStage(const std::string & stage);
+  MemoryLoadType
+  SampleMemory();
+  void
+  CountVoxels(const ImageBase<3> * image);
+  template <typename TOptimizer>
+  void
+  ObserveOptimizer(TOptimizer * optimizer);
 
   void
   RescaleImages();
@@ -166,15 +410,37 @@ private:
   void
   AffineRegistration();
   void
+  RigidRegistrationv4();
+  void
+  AffineRegistrationv4();
+  template <typename TTransform>
+  void
+  Registrationv4(TTransform * transform, unsigned int numberOfIterations, float progressWeight);
+  void
+  ResampleAtlasImage(const TransformBaseType * transform, float progressWeight);
+  void
+  ResampleAtlasLabels(const TransformBaseType * transform, float progressWeight);
+  void
   BinaryErosion();
   void
+  DistanceMapErosion();
+  void
+  ComputeBrainRegion();
+  void
   MultiResLevelSet();
   void
   PyramidFilter(int isoSpacing);
   void
+  ResampleLevelSet(const PointType & origin, const Vector<double, 3> & extent, int isoSpacing);
+  void
   InversePyramidFilter();
   void
   LevelSetRefinement(int isoSpacing);
+  LevelSetImagePointer
+  FeatureImage();
+  template <typename TLevelSetFilter>
+  void
+  ConfigureLevelSet(TLevelSetFilter * levelSet, int isoSpacing) const;
   void
   UpsampleLabels();
 
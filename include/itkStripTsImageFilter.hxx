@@ -22,109 +22,326 @@
 
 #include "itkLabelImageGaussianInterpolateImageFunction.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace itk
 {
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::StripTsImageFilter()
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::StripTsImageFilter()
 {
   // constructor
   m_PatientImage = ImageType::New();
-  m_AtlasImage = AtlasImageType::New();
+  m_AtlasImage = AtlasRegistrationImageType::New();
   m_AtlasLabels = AtlasLabelType::New();
   m_Progress = nullptr;
   m_TimerReport = "";
+  m_UseNarrowBandLevelSet = false;
+  m_UseDistanceMapErosion = false;
+  m_ErosionRadius = 3.0;
+  m_CropToBrainRegion = false;
+  m_BrainRegionMargin = 25.0;
+  m_BrainRegionOrigin.Fill(0.0);
+  m_BrainRegionExtent.Fill(0.0);
+  m_FeatureImageSampledPeakMemory = 0;
+  m_ComposeRegistrationTransforms = true;
+  m_UseRegistrationv4 = false;
+  m_MetricSamplingStrategy = MetricSamplingStrategyEnum::RANDOM;
+  m_MetricSamplingPercentage = 0.2;
+  m_UseHeadMask = true;
+  m_HeadMaskThreshold = 10.0;
+  m_LowMemoryMode = false;
+  m_StageClock = 0;
+  m_MemoryReport = "";
 }
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::~StripTsImageFilter() = default;
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::~StripTsImageFilter() = default;
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::GenerateData()
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::GenerateData()
 {
   // do the processing
 
   m_Progress = ProgressAccumulator::New();
   m_Progress->SetMiniPipelineFilter(this);
+  m_FeatureImageSampledPeakMemory = 0;
+  m_StageMetrics.clear();
 
-  m_Timer.Start("1 DownsampleImage");
+  this->StartStage("1 DownsampleImage");
   this->DownsampleImage();
-  m_Timer.Stop("1 DownsampleImage");
+  this->CountVoxels(m_PatientImage);
+  this->StopStage("1 DownsampleImage");
 
-  m_Timer.Start("2 RescaleImages");
+  this->StartStage("2 RescaleImages");
   this->RescaleImages();
-  m_Timer.Stop("2 RescaleImages");
+  this->CountVoxels(m_RegistrationImage);
+  this->StopStage("2 RescaleImages");
+
+  this->StartStage("3 RigidRegistration");
+  if (m_UseRegistrationv4)
+  {
+    this->RigidRegistrationv4();
+  }
+  else
+  {
+    this->RigidRegistration();
+  }
+  this->CountVoxels(m_RegistrationImage);
+  this->StopStage("3 RigidRegistration");
 
-  m_Timer.Start("3 RigidRegistration");
-  this->RigidRegistration();
-  m_Timer.Stop("3 RigidRegistration");
+  this->StartStage("4 AffineRegistration");
+  if (m_UseRegistrationv4)
+  {
+    this->AffineRegistrationv4();
+  }
+  else
+  {
+    this->AffineRegistration();
+  }
+  this->CountVoxels(m_RegistrationImage);
+
+  // registration images are not needed after the registration
+  m_RegistrationImage = nullptr;
+  m_AtlasImage = nullptr;
+  m_AtlasInUse = nullptr;
+  this->StopStage("4 AffineRegistration");
 
-  m_Timer.Start("4 AffineRegistration");
-  this->AffineRegistration();
-  m_Timer.Stop("4 AffineRegistration");
+  if (m_CropToBrainRegion)
+  {
+    this->StartStage("4a BrainRegion");
+    this->ComputeBrainRegion();
+    this->CountVoxels(m_AtlasLabels);
+    this->StopStage("4a BrainRegion");
+  }
 
-  m_Timer.Start("5 BinaryErosion");
-  this->BinaryErosion();
-  m_Timer.Stop("5 BinaryErosion");
+  const std::string erosionStage = m_UseDistanceMapErosion ? "5 DistanceMapErosion" : "5 BinaryErosion";
+  this->StartStage(erosionStage);
+  if (m_UseDistanceMapErosion)
+  {
+    this->DistanceMapErosion();
+    this->CountVoxels(m_LevelSet);
+  }
+  else
+  {
+    this->BinaryErosion();
+    this->CountVoxels(m_AtlasLabels);
+  }
+  this->StopStage(erosionStage);
 
-  m_Timer.Start("6 LevelSet");
+  this->StartStage("6 LevelSet");
   this->MultiResLevelSet();
-  m_Timer.Stop("6 LevelSet");
+  this->StopStage("6 LevelSet");
 
-  m_Timer.Start("7 UpsampleLabels");
+  this->StartStage("7 UpsampleLabels");
   this->UpsampleLabels();
-  m_Timer.Stop("7 UpsampleLabels");
+  this->CountVoxels(m_AtlasLabels);
+  this->StopStage("7 UpsampleLabels");
 
   std::ostringstream report;
 
   m_Timer.Report(report);
   m_TimerReport = report.str();
 
+  std::ostringstream memoryReport;
+  memoryReport << "Sampled peak memory (kB)" << std::endl;
+  for (const StageMetricsType & stage : m_StageMetrics)
+  {
+    memoryReport << stage.Name << "\t" << stage.SampledPeakMemory << std::endl;
+  }
+  m_MemoryReport = memoryReport.str();
+
   this->GraftOutput(m_AtlasLabels);
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::PrintSelf(std::ostream & os, Indent indent) const
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::PrintSelf(std::ostream & os,
+                                                                                           Indent         indent) const
 {
   Superclass::PrintSelf(os, indent);
 
+  itkPrintSelfObjectMacro(PreparedAtlas);
+  os << indent << "UseNarrowBandLevelSet: " << (m_UseNarrowBandLevelSet ? "On" : "Off") << std::endl;
+  os << indent << "UseDistanceMapErosion: " << (m_UseDistanceMapErosion ? "On" : "Off") << std::endl;
+  os << indent << "ErosionRadius: " << m_ErosionRadius << std::endl;
+  os << indent << "UseRegistrationv4: " << (m_UseRegistrationv4 ? "On" : "Off") << std::endl;
+  os << indent << "MetricSamplingStrategy: " << m_MetricSamplingStrategy << std::endl;
+  os << indent << "MetricSamplingPercentage: " << m_MetricSamplingPercentage << std::endl;
+  os << indent << "UseHeadMask: " << (m_UseHeadMask ? "On" : "Off") << std::endl;
+  os << indent << "HeadMaskThreshold: " << m_HeadMaskThreshold << std::endl;
+  os << indent << "ComposeRegistrationTransforms: " << (m_ComposeRegistrationTransforms ? "On" : "Off") << std::endl;
+  os << indent << "CropToBrainRegion: " << (m_CropToBrainRegion ? "On" : "Off") << std::endl;
+  os << indent << "BrainRegionMargin: " << m_BrainRegionMargin << std::endl;
+  os << indent << "LowMemoryMode: " << (m_LowMemoryMode ? "On" : "Off") << std::endl;
+  os << indent << "FeatureImageSampledPeakMemory: " << m_FeatureImageSampledPeakMemory << " kB" << std::endl;
+
   os << indent << "end of PrintSelf." << std::endl;
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::ConfigureInternalFilter(
+  ProcessObject * filter) const
+{
+  // internal filters share the work units of this filter, so a batch
+  // running several subjects side by side can split its thread budget
+  filter->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::StartStage(const std::string & stage)
+{
+  // metrics use the stage name without the ordinal of the timer label
+  m_CurrentStage = StageMetricsType();
+  m_CurrentStage.Name = stage.substr(stage.find(' ') + 1);
+  m_CurrentStage.NumberOfWorkUnits = this->GetNumberOfWorkUnits();
+  this->SampleMemory();
+
+  m_Timer.Start(stage.c_str());
+  m_StageProbe.Reset();
+  m_StageProbe.Start();
+  m_StageClock = std::clock();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::StopStage(const std::string & stage)
+{
+  m_CurrentStage.CPUTime = static_cast<double>(std::clock() - m_StageClock) / CLOCKS_PER_SEC;
+  m_StageProbe.Stop();
+  m_Timer.Stop(stage.c_str());
+  m_CurrentStage.WallTime = m_StageProbe.GetTotal();
+  this->SampleMemory();
+
+  m_StageMetrics.push_back(m_CurrentStage);
+
+  this->InvokeEvent(StripTsStageEndEvent());
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+auto
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::SampleMemory() -> MemoryLoadType
+{
+  // memory is only sampled between internal filters, large stages sample after each of them
+  const MemoryLoadType memory = m_MemoryObserver.GetMemoryUsage();
+  m_CurrentStage.SampledPeakMemory = std::max<MemoryLoadType>(m_CurrentStage.SampledPeakMemory, memory);
+  return memory;
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::CountVoxels(const ImageBase<3> * image)
+{
+  m_CurrentStage.NumberOfVoxels += image->GetLargestPossibleRegion().GetNumberOfPixels();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+template <typename TOptimizer>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::SetAtlasImage(const TAtlasImageType * ptr)
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::ObserveOptimizer(
+  TOptimizer * optimizer)
 {
-  m_AtlasImage = const_cast<TAtlasImageType *>(ptr);
+  // the optimizer ends once per registration level
+  optimizer->AddObserver(itk::EndEvent(), [this, optimizer](const itk::EventObject &) {
+    m_CurrentStage.Iterations.push_back(optimizer->GetCurrentIteration());
+    m_CurrentStage.MetricValues.push_back(optimizer->GetValue());
+  });
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+std::string
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::GetMetricsAsJSON() const
+{
+  // stage names are plain identifiers, nothing has to be escaped
+  const auto writeNumber = [](std::ostream & os, double value) {
+    if (std::isfinite(value))
+    {
+      os << value;
+    }
+    else
+    {
+      os << "null";
+    }
+  };
+  const auto writeArray = [&writeNumber](std::ostream & os, const auto & values) {
+    os << "[";
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+      os << (i > 0 ? ", " : "");
+      writeNumber(os, static_cast<double>(values[i]));
+    }
+    os << "]";
+  };
+
+  std::ostringstream json;
+  json.precision(10);
+  json << "{" << std::endl << "  \"stages\": [";
+  for (size_t i = 0; i < m_StageMetrics.size(); ++i)
+  {
+    const StageMetricsType & stage = m_StageMetrics[i];
+    json << (i > 0 ? "," : "") << std::endl;
+    json << "    {\"name\": \"" << stage.Name << "\"";
+    json << ", \"wallTime\": ";
+    writeNumber(json, stage.WallTime);
+    json << ", \"cpuTime\": ";
+    writeNumber(json, stage.CPUTime);
+    json << ", \"workUnits\": " << stage.NumberOfWorkUnits;
+    json << ", \"sampledPeakMemory\": " << stage.SampledPeakMemory;
+    json << ", \"voxels\": " << stage.NumberOfVoxels;
+    json << ", \"iterations\": ";
+    writeArray(json, stage.Iterations);
+    json << ", \"metricValues\": ";
+    writeArray(json, stage.MetricValues);
+    json << ", \"rmsChanges\": ";
+    writeArray(json, stage.RMSChanges);
+    json << "}";
+  }
+  json << std::endl << "  ]" << std::endl << "}" << std::endl;
+  return json.str();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::SetAtlasImage(
+  const TAtlasImageType * ptr)
+{
+  m_InputAtlasImage = ptr;
+  this->Modified();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::SetAtlasBrainMask(const TAtlasLabelType * ptr)
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::SetAtlasBrainMask(
+  const TAtlasLabelType * ptr)
 {
-  m_AtlasLabels = const_cast<TAtlasLabelType *>(ptr);
+  m_InputAtlasLabels = ptr;
+  this->Modified();
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::DownsampleImage()
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::DownsampleImage()
 {
   // resample patient image to isotropic resolution
 
-  // duplicate image
-  using DuplicatorType = itk::ImageDuplicator<TImageType>;
-  typename DuplicatorType::Pointer duplicator = DuplicatorType::New();
-  duplicator->SetInputImage(this->GetInput());
-  duplicator->Update();
-  m_PatientImage = duplicator->GetOutput();
-  m_PatientImage->DisconnectPipeline();
+  // the input is only read by the resampler, no copy needed
+  const ImageType * input = this->GetInput();
 
   // resample image
   using ResamplerType = itk::ResampleImageFilter<TImageType, TImageType>;
@@ -139,33 +356,43 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::DownsampleImag
   transform->SetIdentity();
 
   resampler->SetTransform(transform);
-  resampler->SetInput(m_PatientImage);
+  resampler->SetInput(input);
 
   typename TImageType::SpacingType spacing;
   typename TImageType::SizeType    size;
   spacing[0] = 1.0;
   spacing[1] = 1.0;
   spacing[2] = 1.0;
-  size[0] = (m_PatientImage->GetLargestPossibleRegion().GetSize()[0]) * (m_PatientImage->GetSpacing()[0]) / spacing[0];
-  size[1] = (m_PatientImage->GetLargestPossibleRegion().GetSize()[1]) * (m_PatientImage->GetSpacing()[1]) / spacing[1];
-  size[2] = (m_PatientImage->GetLargestPossibleRegion().GetSize()[2]) * (m_PatientImage->GetSpacing()[2]) / spacing[2];
+  size[0] = (input->GetLargestPossibleRegion().GetSize()[0]) * (input->GetSpacing()[0]) / spacing[0];
+  size[1] = (input->GetLargestPossibleRegion().GetSize()[1]) * (input->GetSpacing()[1]) / spacing[1];
+  size[2] = (input->GetLargestPossibleRegion().GetSize()[2]) * (input->GetSpacing()[2]) / spacing[2];
+
+  // the registration needs at least one voxel of the 1mm grid along each axis
+  for (unsigned int dim = 0; dim < 3; ++dim)
+  {
+    if (size[dim] == 0)
+    {
+      itkExceptionMacro(<< "DownsampleImage() failed: patient image is smaller than 1mm along dimension " << dim);
+    }
+  }
 
+  this->ConfigureInternalFilter(resampler);
   resampler->SetInterpolator(lInterp);
   resampler->SetSize(size);
   resampler->SetOutputSpacing(spacing);
-  resampler->SetOutputOrigin(m_PatientImage->GetOrigin());
-  resampler->SetOutputDirection(m_PatientImage->GetDirection());
+  resampler->SetOutputOrigin(input->GetOrigin());
+  resampler->SetOutputDirection(input->GetDirection());
   resampler->SetDefaultPixelValue(0);
 
   try
   {
     m_Progress->RegisterInternalFilter(resampler, 0.004f);
     resampler->Update();
+    this->SampleMemory();
   }
   catch (itk::ExceptionObject & exception)
   {
-    std::cerr << "ExceptionObject caught !" << std::endl;
-    std::cerr << exception << std::endl;
+    itkExceptionMacro(<< "DownsampleImage() failed: " << exception.GetDescription());
   }
 
   m_PatientImage = resampler->GetOutput();
@@ -173,69 +400,91 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::DownsampleImag
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::RescaleImages()
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::RescaleImages()
 {
   // rescale patient image and atlas image intensities to 0-255
 
-  using ImageRescalerType = itk::RescaleIntensityImageFilter<TImageType, TImageType>;
+  using ImageRescalerType = itk::RescaleIntensityImageFilter<ImageType, RegistrationImageType>;
   typename ImageRescalerType::Pointer imageRescaler = ImageRescalerType::New();
 
-  using AtlasRescalerType = itk::RescaleIntensityImageFilter<TAtlasImageType, TAtlasImageType>;
-  typename AtlasRescalerType::Pointer atlasRescaler = AtlasRescalerType::New();
-
+  this->ConfigureInternalFilter(imageRescaler);
   imageRescaler->SetInput(m_PatientImage);
   imageRescaler->SetOutputMinimum(0);
   imageRescaler->SetOutputMaximum(255);
 
-  atlasRescaler->SetInput(m_AtlasImage);
-  atlasRescaler->SetOutputMinimum(0);
-  atlasRescaler->SetOutputMaximum(255);
-
   try
   {
-    m_Progress->RegisterInternalFilter(atlasRescaler, 0.001f);
     imageRescaler->Update();
-    atlasRescaler->Update();
   }
   catch (itk::ExceptionObject & err)
   {
-    std::cerr << "Exception caught" << std::endl;
-    std::cerr << err << std::endl;
+    itkExceptionMacro(<< "RescaleImages() failed: " << err.GetDescription());
   }
 
-  m_PatientImage = imageRescaler->GetOutput();
-  m_PatientImage->DisconnectPipeline();
+  m_RegistrationImage = imageRescaler->GetOutput();
+  m_RegistrationImage->DisconnectPipeline();
+  m_PatientImage = nullptr;
 
-  m_AtlasImage = atlasRescaler->GetOutput();
-  m_AtlasImage->DisconnectPipeline();
+  // the atlas is rescaled, pyramided and binarized only once per prepared atlas
+  if (m_PreparedAtlas.IsNotNull())
+  {
+    if (!m_PreparedAtlas->IsPrepared())
+    {
+      itkExceptionMacro(<< "RescaleImages() failed: the prepared atlas has no images, call its Prepare() or Read()"
+                        << " before running the filter");
+    }
+    m_AtlasInUse = m_PreparedAtlas;
+  }
+  else
+  {
+    typename PreparedAtlasType::Pointer preparedAtlas = PreparedAtlasType::New();
+    preparedAtlas->SetAtlasImage(m_InputAtlasImage);
+    preparedAtlas->SetAtlasBrainMask(m_InputAtlasLabels);
+    try
+    {
+      preparedAtlas->Prepare();
+    }
+    catch (itk::ExceptionObject & err)
+    {
+      itkExceptionMacro(<< "RescaleImages() failed: " << err.GetDescription());
+    }
+    m_AtlasInUse = preparedAtlas;
+  }
+
+  // work on views of the prepared images, the prepared atlas itself is never modified
+  m_AtlasImage = AtlasRegistrationImageType::New();
+  m_AtlasImage->Graft(m_AtlasInUse->GetAtlasImage());
+
+  m_AtlasLabels = AtlasLabelType::New();
+  m_AtlasLabels->Graft(m_AtlasInUse->GetAtlasLabels());
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::RigidRegistration()
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::RigidRegistration()
 {
   // perform intial rigid alignment of atlas with patient image
 
   //  std::cout << "Doing initial rigid mask alignment" << std::endl;
 
-  using TransformType = itk::VersorRigid3DTransform<double>;
+  using TransformType = RigidTransformType;
   using OptimizerType = itk::VersorRigid3DTransformOptimizer;
-  using MetricType = itk::MattesMutualInformationImageToImageMetric<TImageType, TAtlasImageType>;
-  using MultiResRegistrationType = itk::MultiResolutionImageRegistrationMethod<TImageType, TAtlasImageType>;
-  using LinearInterpolatorType = itk::LinearInterpolateImageFunction<TAtlasImageType, double>;
-  using NNInterpolatorType = itk::NearestNeighborInterpolateImageFunction<TAtlasLabelType, double>;
-  //  using NNInterpolatorType = itk::LabelImageGaussianInterpolateImageFunction<TAtlasLabelType, double>;
+  using MetricType = itk::MattesMutualInformationImageToImageMetric<RegistrationImageType, AtlasRegistrationImageType>;
+  using MultiResRegistrationType =
+    itk::MultiResolutionImageRegistrationMethod<RegistrationImageType, AtlasRegistrationImageType>;
+  using LinearInterpolatorType = itk::LinearInterpolateImageFunction<AtlasRegistrationImageType, double>;
 
   typename TransformType::Pointer            transform = TransformType::New();
   typename OptimizerType::Pointer            optimizer = OptimizerType::New();
   typename MetricType::Pointer               metric = MetricType::New();
   typename MultiResRegistrationType::Pointer registration = MultiResRegistrationType::New();
   typename LinearInterpolatorType::Pointer   linearInterpolator = LinearInterpolatorType::New();
-  typename NNInterpolatorType::Pointer       nnInterpolator = NNInterpolatorType::New();
 
+  this->ConfigureInternalFilter(registration);
+  metric->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
   metric->SetNumberOfHistogramBins(64);
   metric->SetNumberOfSpatialSamples(100000); // default number is too small
 
@@ -244,30 +493,25 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::RigidRegistrat
   registration->SetInterpolator(linearInterpolator);
   // registration->SetNumberOfLevels( 3 );
 
-  // perform registration only on subsampled image for speed gains
-  typename MultiResRegistrationType::ScheduleType schedule;
-  schedule.SetSize(2, 3);
-  schedule[0][0] = 4;
-  schedule[0][1] = 4;
-  schedule[0][2] = 4;
-  schedule[1][0] = 2;
-  schedule[1][1] = 2;
-  schedule[1][2] = 2;
-  registration->SetSchedules(schedule, schedule);
-
-  registration->SetFixedImageRegion(m_PatientImage->GetBufferedRegion());
+  // perform registration only on subsampled image for speed gains,
+  // the atlas levels of the pyramid have been computed beforehand
+  registration->SetSchedules(m_AtlasInUse->GetSchedule(), m_AtlasInUse->GetSchedule());
+  registration->SetMovingImagePyramid(m_AtlasInUse->CreateMovingImagePyramid());
+
+  registration->SetFixedImageRegion(m_RegistrationImage->GetBufferedRegion());
 
   registration->SetTransform(transform);
 
-  registration->SetFixedImage(m_PatientImage);
+  registration->SetFixedImage(m_RegistrationImage);
   registration->SetMovingImage(m_AtlasImage);
 
   // transform initialization
-  using TransformInitializerType = itk::CenteredTransformInitializer<TransformType, TImageType, TAtlasImageType>;
+  using TransformInitializerType =
+    itk::CenteredTransformInitializer<TransformType, RegistrationImageType, AtlasRegistrationImageType>;
   typename TransformInitializerType::Pointer initializer = TransformInitializerType::New();
 
   initializer->SetTransform(transform);
-  initializer->SetFixedImage(m_PatientImage);
+  initializer->SetFixedImage(m_RegistrationImage);
   initializer->SetMovingImage(m_AtlasImage);
 
   initializer->GeometryOn(); // geometry initialization because of multimodality
@@ -278,8 +522,7 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::RigidRegistrat
   }
   catch (itk::ExceptionObject & exception)
   {
-    std::cerr << "Exception caught ! " << std::endl;
-    std::cerr << &exception << std::endl;
+    itkExceptionMacro(<< "RigidRegistration() failed: " << exception.GetDescription());
   }
 
   registration->SetInitialTransformParameters(transform->GetParameters());
@@ -301,107 +544,59 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::RigidRegistrat
   optimizer->SetMinimumStepLength(0.001);
   optimizer->SetNumberOfIterations(250);
   optimizer->MinimizeOn();
+  this->ObserveOptimizer(optimizer.GetPointer());
 
   try
   {
     m_Progress->RegisterInternalFilter(registration, 0.29f);
     registration->Update();
+    this->SampleMemory();
   }
   catch (itk::ExceptionObject & exception)
   {
-    std::cerr << "ExceptionObject caught !" << std::endl;
-    std::cerr << exception << std::endl;
+    itkExceptionMacro(<< "RigidRegistration() failed: " << exception.GetDescription());
   }
 
   typename OptimizerType::ParametersType finalParameters = registration->GetLastTransformParameters();
 
   transform->SetParameters(finalParameters);
 
-  // resample atlas image
-  using ResampleImageFilterType = itk::ResampleImageFilter<TAtlasImageType, TAtlasImageType>;
-  typename ResampleImageFilterType::Pointer imageResampler = ResampleImageFilterType::New();
-
-  typename TransformType::Pointer finalTransform = TransformType::New();
-  finalTransform->SetCenter(transform->GetCenter());
-  finalTransform->SetParameters(finalParameters);
-
-
-  imageResampler->SetTransform(finalTransform);
-  imageResampler->SetInterpolator(linearInterpolator);
+  m_RigidTransform = TransformType::New();
+  m_RigidTransform->SetCenter(transform->GetCenter());
+  m_RigidTransform->SetParameters(finalParameters);
 
-  imageResampler->SetSize(m_PatientImage->GetLargestPossibleRegion().GetSize());
-  imageResampler->SetOutputOrigin(m_PatientImage->GetOrigin());
-  imageResampler->SetOutputSpacing(m_PatientImage->GetSpacing());
-  imageResampler->SetOutputDirection(m_PatientImage->GetDirection());
-  imageResampler->SetDefaultPixelValue(0);
-
-  imageResampler->SetInput(m_AtlasImage);
-  try
-  {
-    m_Progress->RegisterInternalFilter(imageResampler, 0.24f);
-    imageResampler->Update();
-  }
-  catch (itk::ExceptionObject & exception)
+  // composed transforms resample the atlas only once, after the affine stage
+  if (!m_ComposeRegistrationTransforms)
   {
-    std::cerr << "ExceptionObject caught !" << std::endl;
-    std::cerr << exception << std::endl;
+    this->ResampleAtlasImage(m_RigidTransform, 0.24f);
+    this->ResampleAtlasLabels(m_RigidTransform, 0.01f);
   }
-
-  m_AtlasImage = imageResampler->GetOutput();
-  m_AtlasImage->DisconnectPipeline();
-
-  // resample atlas mask
-  using ResampleLabelFilterType = itk::ResampleImageFilter<TAtlasLabelType, TAtlasLabelType>;
-  typename ResampleLabelFilterType::Pointer labelResampler = ResampleLabelFilterType::New();
-
-  labelResampler->SetTransform(finalTransform);
-  labelResampler->SetInterpolator(nnInterpolator);
-
-  labelResampler->SetSize(m_PatientImage->GetLargestPossibleRegion().GetSize());
-  labelResampler->SetOutputOrigin(m_PatientImage->GetOrigin());
-  labelResampler->SetOutputSpacing(m_PatientImage->GetSpacing());
-  labelResampler->SetOutputDirection(m_PatientImage->GetDirection());
-  labelResampler->SetDefaultPixelValue(0);
-
-  labelResampler->SetInput(m_AtlasLabels);
-  try
-  {
-    m_Progress->RegisterInternalFilter(labelResampler, 0.01f);
-    labelResampler->Update();
-  }
-  catch (itk::ExceptionObject & exception)
-  {
-    std::cerr << "ExceptionObject caught !" << std::endl;
-    std::cerr << exception << std::endl;
-  }
-
-  m_AtlasLabels = labelResampler->GetOutput();
-  m_AtlasLabels->DisconnectPipeline();
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::AffineRegistration()
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::AffineRegistration()
 {
   // perform refined affine alignment of atlas with patient image
 
   //  std::cout << "Doing affine mask alignment" << std::endl;
 
-  using TransformType = itk::AffineTransform<double, 3>;
+  using TransformType = AffineTransformType;
   using OptimizerType = itk::RegularStepGradientDescentOptimizer;
-  using MetricType = itk::MattesMutualInformationImageToImageMetric<TImageType, TAtlasImageType>;
-  using MultiResRegistrationType = itk::MultiResolutionImageRegistrationMethod<TImageType, TAtlasImageType>;
-  using LinearInterpolatorType = itk::LinearInterpolateImageFunction<TAtlasImageType, double>;
-  using NNInterpolatorType = itk::NearestNeighborInterpolateImageFunction<TAtlasLabelType, double>;
+  using MetricType = itk::MattesMutualInformationImageToImageMetric<RegistrationImageType, AtlasRegistrationImageType>;
+  using MultiResRegistrationType =
+    itk::MultiResolutionImageRegistrationMethod<RegistrationImageType, AtlasRegistrationImageType>;
+  using LinearInterpolatorType = itk::LinearInterpolateImageFunction<AtlasRegistrationImageType, double>;
 
   typename TransformType::Pointer            transform = TransformType::New();
   typename OptimizerType::Pointer            optimizer = OptimizerType::New();
   typename MetricType::Pointer               metric = MetricType::New();
   typename MultiResRegistrationType::Pointer registration = MultiResRegistrationType::New();
   typename LinearInterpolatorType::Pointer   linearInterpolator = LinearInterpolatorType::New();
-  typename NNInterpolatorType::Pointer       nnInterpolator = NNInterpolatorType::New();
 
+  this->ConfigureInternalFilter(registration);
+  metric->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
   metric->SetNumberOfHistogramBins(64);
   metric->SetNumberOfSpatialSamples(100000); // default number is too small
 
@@ -411,24 +606,31 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::AffineRegistra
   // registration->SetNumberOfLevels( 3 );
 
   // perform registration only on subsampled image for speed gains
-  typename MultiResRegistrationType::ScheduleType schedule;
-  schedule.SetSize(2, 3);
-  schedule[0][0] = 4;
-  schedule[0][1] = 4;
-  schedule[0][2] = 4;
-  schedule[1][0] = 2;
-  schedule[1][1] = 2;
-  schedule[1][2] = 2;
-  registration->SetSchedules(schedule, schedule);
-
-  registration->SetFixedImageRegion(m_PatientImage->GetBufferedRegion());
+  registration->SetSchedules(m_AtlasInUse->GetSchedule(), m_AtlasInUse->GetSchedule());
+  if (m_ComposeRegistrationTransforms)
+  {
+    // atlas has not been resampled by the rigid stage, its pyramid levels can be reused
+    registration->SetMovingImagePyramid(m_AtlasInUse->CreateMovingImagePyramid());
+  }
+
+  registration->SetFixedImageRegion(m_RegistrationImage->GetBufferedRegion());
 
   registration->SetTransform(transform);
 
-  registration->SetFixedImage(m_PatientImage);
+  registration->SetFixedImage(m_RegistrationImage);
   registration->SetMovingImage(m_AtlasImage);
 
-  transform->SetIdentity();
+  if (m_ComposeRegistrationTransforms)
+  {
+    // start from the rigid alignment, the final transform maps directly to the atlas
+    transform->SetCenter(m_RigidTransform->GetCenter());
+    transform->SetMatrix(m_RigidTransform->GetMatrix());
+    transform->SetTranslation(m_RigidTransform->GetTranslation());
+  }
+  else
+  {
+    transform->SetIdentity();
+  }
   registration->SetInitialTransformParameters(transform->GetParameters());
 
   using OptimizerScalesType = OptimizerType::ScalesType;
@@ -454,101 +656,294 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::AffineRegistra
   optimizer->SetMinimumStepLength(0.001);
   optimizer->SetNumberOfIterations(200);
   optimizer->MinimizeOn();
+  this->ObserveOptimizer(optimizer.GetPointer());
 
   try
   {
     m_Progress->RegisterInternalFilter(registration, 0.24f);
     registration->Update();
+    this->SampleMemory();
   }
   catch (itk::ExceptionObject & exception)
   {
-    std::cerr << "ExceptionObject caught !" << std::endl;
-    std::cerr << exception << std::endl;
+    itkExceptionMacro(<< "AffineRegistration() failed: " << exception.GetDescription());
   }
 
   typename OptimizerType::ParametersType finalParameters = registration->GetLastTransformParameters();
 
   transform->SetParameters(finalParameters);
 
-  // resample atlas image
-  using ResampleImageFilterType = itk::ResampleImageFilter<TAtlasImageType, TAtlasImageType>;
-  typename ResampleImageFilterType::Pointer imageResampler = ResampleImageFilterType::New();
-
   typename TransformType::Pointer finalTransform = TransformType::New();
   finalTransform->SetCenter(transform->GetCenter());
   finalTransform->SetParameters(finalParameters);
 
+  // only the mask is used by the following stages, the atlas intensities are not resampled again
+  this->ResampleAtlasLabels(finalTransform, 0.01f);
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::RigidRegistrationv4()
+{
+  // initial rigid alignment of atlas with patient image, ITKv4 registration framework
+
+  typename RigidTransformType::Pointer transform = RigidTransformType::New();
+
+  // transform initialization
+  using TransformInitializerType =
+    itk::CenteredTransformInitializer<RigidTransformType, RegistrationImageType, AtlasRegistrationImageType>;
+  typename TransformInitializerType::Pointer initializer = TransformInitializerType::New();
+
+  initializer->SetTransform(transform);
+  initializer->SetFixedImage(m_RegistrationImage);
+  initializer->SetMovingImage(m_AtlasImage);
+
+  initializer->GeometryOn(); // geometry initialization because of multimodality
+
+  try
+  {
+    initializer->InitializeTransform();
+  }
+  catch (itk::ExceptionObject & exception)
+  {
+    itkExceptionMacro(<< "RigidRegistrationv4() failed: " << exception.GetDescription());
+  }
+
+  this->Registrationv4(transform.GetPointer(), 250, 0.29f);
+
+  m_RigidTransform = transform;
+
+  // composed transforms resample the atlas only once, after the affine stage
+  if (!m_ComposeRegistrationTransforms)
+  {
+    this->ResampleAtlasImage(m_RigidTransform, 0.24f);
+    this->ResampleAtlasLabels(m_RigidTransform, 0.01f);
+  }
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::AffineRegistrationv4()
+{
+  // refined affine alignment of atlas with patient image, ITKv4 registration framework
+
+  typename AffineTransformType::Pointer transform = AffineTransformType::New();
+
+  if (m_ComposeRegistrationTransforms)
+  {
+    // start from the rigid alignment, the final transform maps directly to the atlas
+    transform->SetCenter(m_RigidTransform->GetCenter());
+    transform->SetMatrix(m_RigidTransform->GetMatrix());
+    transform->SetTranslation(m_RigidTransform->GetTranslation());
+  }
+  else
+  {
+    transform->SetIdentity();
+  }
+
+  this->Registrationv4(transform.GetPointer(), 200, 0.24f);
+
+  // only the mask is used by the following stages, the atlas intensities are not resampled again
+  this->ResampleAtlasLabels(transform, 0.01f);
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+template <typename TTransform>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::Registrationv4(
+  TTransform * transform,
+  unsigned int numberOfIterations,
+  float        progressWeight)
+{
+  // register atlas to patient image starting from and updating transform
+
+  using MetricType =
+    itk::MattesMutualInformationImageToImageMetricv4<RegistrationImageType, AtlasRegistrationImageType>;
+  using OptimizerType = itk::RegularStepGradientDescentOptimizerv4<double>;
+  using RegistrationType =
+    itk::ImageRegistrationMethodv4<RegistrationImageType, AtlasRegistrationImageType, TTransform>;
+  using ScalesEstimatorType = itk::RegistrationParameterScalesFromPhysicalShift<MetricType>;
 
-  imageResampler->SetTransform(finalTransform);
+  typename MetricType::Pointer          metric = MetricType::New();
+  typename OptimizerType::Pointer       optimizer = OptimizerType::New();
+  typename RegistrationType::Pointer    registration = RegistrationType::New();
+  typename ScalesEstimatorType::Pointer scalesEstimator = ScalesEstimatorType::New();
+
+  metric->SetMaximumNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+  metric->SetNumberOfHistogramBins(64);
+
+  // sample the metric inside the head only, background voxels carry no information
+  if (m_UseHeadMask)
+  {
+    using MaskImageType = itk::Image<unsigned char, 3>;
+    using ThresholderType = itk::BinaryThresholdImageFilter<RegistrationImageType, MaskImageType>;
+    using HeadMaskType = itk::ImageMaskSpatialObject<3>;
+    typename ThresholderType::Pointer thresholder = ThresholderType::New();
+    typename HeadMaskType::Pointer    headMask = HeadMaskType::New();
+
+    this->ConfigureInternalFilter(thresholder);
+    thresholder->SetInput(m_RegistrationImage);
+    thresholder->SetLowerThreshold(static_cast<typename RegistrationImageType::PixelType>(m_HeadMaskThreshold));
+    thresholder->SetInsideValue(1);
+    thresholder->SetOutsideValue(0);
+    try
+    {
+      thresholder->Update();
+    }
+    catch (itk::ExceptionObject & exception)
+    {
+      itkExceptionMacro(<< "Registrationv4() failed: " << exception.GetDescription());
+    }
+
+    headMask->SetImage(thresholder->GetOutput());
+    headMask->Update();
+    metric->SetFixedImageMask(headMask);
+  }
+
+  // parameter scales from the physical shift of the transform, no hand-tuned scales
+  scalesEstimator->SetMetric(metric);
+  scalesEstimator->SetTransformForward(true);
+
+  optimizer->SetScalesEstimator(scalesEstimator);
+  optimizer->SetDoEstimateLearningRateOnce(true);
+  optimizer->SetMinimumStepLength(0.001);
+  optimizer->SetRelaxationFactor(0.5);
+  optimizer->SetNumberOfIterations(numberOfIterations);
+  optimizer->SetReturnBestParametersAndValue(true);
+  this->ObserveOptimizer(optimizer.GetPointer());
+
+  // same levels as the legacy pyramid, smoothing sigmas in voxels
+  const typename PreparedAtlasType::ScheduleType & schedule = m_AtlasInUse->GetSchedule();
+  const unsigned int                               numberOfLevels = schedule.rows();
+
+  typename RegistrationType::ShrinkFactorsArrayType   shrinkFactors(numberOfLevels);
+  typename RegistrationType::SmoothingSigmasArrayType smoothingSigmas(numberOfLevels);
+  for (unsigned int level = 0; level < numberOfLevels; ++level)
+  {
+    shrinkFactors[level] = schedule[level][0];
+    smoothingSigmas[level] = 0.5 * schedule[level][0];
+  }
+
+  this->ConfigureInternalFilter(registration);
+  registration->SetFixedImage(m_RegistrationImage);
+  registration->SetMovingImage(m_AtlasImage);
+  registration->SetMetric(metric);
+  registration->SetOptimizer(optimizer);
+  registration->SetInitialTransform(transform);
+  registration->InPlaceOn();
+
+  registration->SetNumberOfLevels(numberOfLevels);
+  registration->SetShrinkFactorsPerLevel(shrinkFactors);
+  registration->SetSmoothingSigmasPerLevel(smoothingSigmas);
+  registration->SmoothingSigmasAreSpecifiedInPhysicalUnitsOff();
+
+  registration->SetMetricSamplingStrategy(m_MetricSamplingStrategy);
+  registration->SetMetricSamplingPercentage(m_MetricSamplingPercentage);
+
+  try
+  {
+    m_Progress->RegisterInternalFilter(registration, progressWeight);
+    registration->Update();
+    this->SampleMemory();
+  }
+  catch (itk::ExceptionObject & exception)
+  {
+    itkExceptionMacro(<< "Registrationv4() failed: " << exception.GetDescription());
+  }
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::ResampleAtlasImage(
+  const TransformBaseType * transform,
+  float                     progressWeight)
+{
+  // resample atlas image onto the patient grid
+  using ResampleImageFilterType = itk::ResampleImageFilter<AtlasRegistrationImageType, AtlasRegistrationImageType>;
+  using LinearInterpolatorType = itk::LinearInterpolateImageFunction<AtlasRegistrationImageType, double>;
+  typename ResampleImageFilterType::Pointer imageResampler = ResampleImageFilterType::New();
+  typename LinearInterpolatorType::Pointer  linearInterpolator = LinearInterpolatorType::New();
+
+  this->ConfigureInternalFilter(imageResampler);
+  imageResampler->SetTransform(transform);
   imageResampler->SetInterpolator(linearInterpolator);
 
-  imageResampler->SetSize(m_PatientImage->GetLargestPossibleRegion().GetSize());
-  imageResampler->SetOutputOrigin(m_PatientImage->GetOrigin());
-  imageResampler->SetOutputSpacing(m_PatientImage->GetSpacing());
-  imageResampler->SetOutputDirection(m_PatientImage->GetDirection());
+  imageResampler->SetSize(m_RegistrationImage->GetLargestPossibleRegion().GetSize());
+  imageResampler->SetOutputOrigin(m_RegistrationImage->GetOrigin());
+  imageResampler->SetOutputSpacing(m_RegistrationImage->GetSpacing());
+  imageResampler->SetOutputDirection(m_RegistrationImage->GetDirection());
   imageResampler->SetDefaultPixelValue(0);
 
   imageResampler->SetInput(m_AtlasImage);
   try
   {
-    m_Progress->RegisterInternalFilter(imageResampler, 0.01f);
+    m_Progress->RegisterInternalFilter(imageResampler, progressWeight);
     imageResampler->Update();
+    this->SampleMemory();
   }
   catch (itk::ExceptionObject & exception)
   {
-    std::cerr << "ExceptionObject caught !" << std::endl;
-    std::cerr << exception << std::endl;
+    itkExceptionMacro(<< "ResampleAtlasImage() failed: " << exception.GetDescription());
   }
 
   m_AtlasImage = imageResampler->GetOutput();
   m_AtlasImage->DisconnectPipeline();
+  this->CountVoxels(m_AtlasImage);
+}
 
-  // resample atlas mask
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::ResampleAtlasLabels(
+  const TransformBaseType * transform,
+  float                     progressWeight)
+{
+  // resample atlas mask onto the patient grid
   using ResampleLabelFilterType = itk::ResampleImageFilter<TAtlasLabelType, TAtlasLabelType>;
+  using NNInterpolatorType = itk::NearestNeighborInterpolateImageFunction<TAtlasLabelType, double>;
+  //  using NNInterpolatorType = itk::LabelImageGaussianInterpolateImageFunction<TAtlasLabelType, double>;
   typename ResampleLabelFilterType::Pointer labelResampler = ResampleLabelFilterType::New();
+  typename NNInterpolatorType::Pointer      nnInterpolator = NNInterpolatorType::New();
 
-  labelResampler->SetTransform(finalTransform);
+  this->ConfigureInternalFilter(labelResampler);
+  labelResampler->SetTransform(transform);
   labelResampler->SetInterpolator(nnInterpolator);
 
-  labelResampler->SetSize(m_PatientImage->GetLargestPossibleRegion().GetSize());
-  labelResampler->SetOutputOrigin(m_PatientImage->GetOrigin());
-  labelResampler->SetOutputSpacing(m_PatientImage->GetSpacing());
-  labelResampler->SetOutputDirection(m_PatientImage->GetDirection());
+  labelResampler->SetSize(m_RegistrationImage->GetLargestPossibleRegion().GetSize());
+  labelResampler->SetOutputOrigin(m_RegistrationImage->GetOrigin());
+  labelResampler->SetOutputSpacing(m_RegistrationImage->GetSpacing());
+  labelResampler->SetOutputDirection(m_RegistrationImage->GetDirection());
   labelResampler->SetDefaultPixelValue(0);
 
   labelResampler->SetInput(m_AtlasLabels);
   try
   {
-    m_Progress->RegisterInternalFilter(labelResampler, 0.01f);
+    m_Progress->RegisterInternalFilter(labelResampler, progressWeight);
     labelResampler->Update();
+    this->SampleMemory();
   }
   catch (itk::ExceptionObject & exception)
   {
-    std::cerr << "ExceptionObject caught !" << std::endl;
-    std::cerr << exception << std::endl;
+    itkExceptionMacro(<< "ResampleAtlasLabels() failed: " << exception.GetDescription());
   }
 
   m_AtlasLabels = labelResampler->GetOutput();
   m_AtlasLabels->DisconnectPipeline();
+  this->CountVoxels(m_AtlasLabels);
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::BinaryErosion()
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::BinaryErosion()
 {
   //  std::cout << "Eroding aligned mask" << std::endl;
 
-  // make sure mask is binary
-  itk::ImageRegionIterator<AtlasLabelType> iterLabel(m_AtlasLabels, m_AtlasLabels->GetLargestPossibleRegion());
-
-  for (iterLabel.GoToBegin(); !iterLabel.IsAtEnd(); ++iterLabel)
-  {
-    if (iterLabel.Get() != 0)
-    {
-      iterLabel.Set(1);
-    }
-  }
+  // mask is binary already, it was binarized when the atlas was prepared
 
   // erode binary mask
   using StructuringElementType = itk::BinaryBallStructuringElement<typename AtlasLabelType::PixelType, 3>;
@@ -560,6 +955,7 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::BinaryErosion(
   structuringElement.SetRadius(3);
   structuringElement.CreateStructuringElement();
 
+  this->ConfigureInternalFilter(eroder);
   eroder->SetKernel(structuringElement);
   eroder->SetInput(m_AtlasLabels);
   eroder->SetErodeValue(1);
@@ -569,11 +965,11 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::BinaryErosion(
   {
     m_Progress->RegisterInternalFilter(eroder, 0.02f);
     eroder->Update();
+    this->SampleMemory();
   }
   catch (itk::ExceptionObject & err)
   {
-    std::cerr << "ExceptionObject caught while dilating mask!" << std::endl;
-    std::cerr << err << std::endl;
+    itkExceptionMacro(<< "BinaryErosion() failed: " << err.GetDescription());
   }
 
   m_AtlasLabels = eroder->GetOutput();
@@ -581,9 +977,104 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::BinaryErosion(
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::DistanceMapErosion()
+{
+  // erode the mask by thresholding its signed distance map, which is
+  // kept as initial level set of the geodesic active contour
+
+  // signed distance to the mask boundary in mm, positive inside
+  using DistanceMapFilterType = itk::SignedMaurerDistanceMapImageFilter<AtlasLabelType, LevelSetImageType>;
+  typename DistanceMapFilterType::Pointer distanceMap = DistanceMapFilterType::New();
+
+  this->ConfigureInternalFilter(distanceMap);
+  distanceMap->SetInput(m_AtlasLabels);
+  distanceMap->SetBackgroundValue(0);
+  distanceMap->InsideIsPositiveOn();
+  distanceMap->SquaredDistanceOff();
+  distanceMap->UseImageSpacingOn();
+
+  // shift in place, so the zero level is the boundary of the eroded mask
+  using ShiftFilterType = itk::AddImageFilter<LevelSetImageType, LevelSetImageType, LevelSetImageType>;
+  typename ShiftFilterType::Pointer shifter = ShiftFilterType::New();
+
+  this->ConfigureInternalFilter(shifter);
+  shifter->SetInput1(distanceMap->GetOutput());
+  shifter->SetConstant2(static_cast<LevelSetPixelType>(-m_ErosionRadius));
+  shifter->InPlaceOn();
+
+  try
+  {
+    m_Progress->RegisterInternalFilter(distanceMap, 0.015f);
+    m_Progress->RegisterInternalFilter(shifter, 0.005f);
+    shifter->Update();
+    this->SampleMemory();
+  }
+  catch (itk::ExceptionObject & err)
+  {
+    itkExceptionMacro(<< "DistanceMapErosion() failed: " << err.GetDescription());
+  }
+
+  m_LevelSet = shifter->GetOutput();
+  m_LevelSet->DisconnectPipeline();
+
+  // nothing reads the eroded mask, the level set replaces it until the refinement thresholds its result
+  m_AtlasLabels = nullptr;
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::MultiResLevelSet()
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::ComputeBrainRegion()
+{
+  // bounding box of the registered atlas mask plus a safety margin,
+  // the level set refinement only runs inside of it
+
+  using RegionType = typename AtlasLabelType::RegionType;
+  using MaskSpatialObjectType = itk::ImageMaskSpatialObject<3, typename AtlasLabelType::PixelType>;
+
+  const RegionType largestRegion = m_AtlasLabels->GetLargestPossibleRegion();
+
+  // scans inwards from the faces of the image, the voxels inside of the box are never visited
+  typename MaskSpatialObjectType::Pointer maskSpatialObject = MaskSpatialObjectType::New();
+  maskSpatialObject->SetImage(m_AtlasLabels);
+
+  RegionType brainRegion;
+  try
+  {
+    brainRegion = maskSpatialObject->ComputeMyBoundingBoxInIndexSpace();
+  }
+  catch (itk::ExceptionObject & excep)
+  {
+    itkExceptionMacro(<< "ComputeBrainRegion() failed: " << excep.GetDescription());
+  }
+  if (brainRegion.GetNumberOfPixels() == 0)
+  {
+    brainRegion = largestRegion;
+  }
+  else
+  {
+    typename RegionType::SizeType padding;
+    for (unsigned int dim = 0; dim < 3; ++dim)
+    {
+      padding[dim] = static_cast<SizeValueType>(std::ceil(m_BrainRegionMargin / m_AtlasLabels->GetSpacing()[dim]));
+    }
+    brainRegion.PadByRadius(padding);
+    brainRegion.Crop(largestRegion);
+  }
+
+  m_AtlasLabels->TransformIndexToPhysicalPoint(brainRegion.GetIndex(), m_BrainRegionOrigin);
+  for (unsigned int dim = 0; dim < 3; ++dim)
+  {
+    m_BrainRegionExtent[dim] = brainRegion.GetSize()[dim] * m_AtlasLabels->GetSpacing()[dim];
+  }
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::MultiResLevelSet()
 {
   // level set refinement of brain mask in two resolution levels
 
@@ -598,12 +1089,15 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::MultiResLevelS
   //  std::cout << "...fine" << std::endl;
   PyramidFilter(1);
   LevelSetRefinement(1);
+
+  // only the mask of the fine level set is used further
+  m_LevelSet = nullptr;
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::PyramidFilter(int isoSpacing)
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::PyramidFilter(int isoSpacing)
 {
   // resample to isoSpacing before applying level set
 
@@ -621,6 +1115,23 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::PyramidFilter(
 
   transform->SetIdentity();
 
+  // resampled domain, the whole input or only the brain region
+  typename ImageType::PointType origin = this->GetInput()->GetOrigin();
+  Vector<double, 3>             extent;
+  for (unsigned int dim = 0; dim < 3; ++dim)
+  {
+    extent[dim] = (this->GetInput()->GetLargestPossibleRegion().GetSize()[dim]) * (this->GetInput()->GetSpacing()[dim]);
+  }
+  if (m_CropToBrainRegion)
+  {
+    origin = m_BrainRegionOrigin;
+    extent = m_BrainRegionExtent;
+  }
+
+  // the patient image of the previous resolution is resampled from the input again, free it first
+  m_PatientImage = nullptr;
+
+  this->ConfigureInternalFilter(imageResampler);
   imageResampler->SetTransform(transform);
   imageResampler->SetInput(this->GetInput());
 
@@ -629,17 +1140,14 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::PyramidFilter(
   imageSpacing[0] = isoSpacing;
   imageSpacing[1] = isoSpacing;
   imageSpacing[2] = isoSpacing;
-  imageSize[0] =
-    (this->GetInput()->GetLargestPossibleRegion().GetSize()[0]) * (this->GetInput()->GetSpacing()[0]) / imageSpacing[0];
-  imageSize[1] =
-    (this->GetInput()->GetLargestPossibleRegion().GetSize()[1]) * (this->GetInput()->GetSpacing()[1]) / imageSpacing[1];
-  imageSize[2] =
-    (this->GetInput()->GetLargestPossibleRegion().GetSize()[2]) * (this->GetInput()->GetSpacing()[2]) / imageSpacing[2];
+  imageSize[0] = extent[0] / imageSpacing[0];
+  imageSize[1] = extent[1] / imageSpacing[1];
+  imageSize[2] = extent[2] / imageSpacing[2];
 
   imageResampler->SetInterpolator(linearInterpolator);
   imageResampler->SetSize(imageSize);
   imageResampler->SetOutputSpacing(imageSpacing);
-  imageResampler->SetOutputOrigin(this->GetInput()->GetOrigin());
+  imageResampler->SetOutputOrigin(origin);
   imageResampler->SetOutputDirection(this->GetInput()->GetDirection());
   imageResampler->SetDefaultPixelValue(0);
 
@@ -649,21 +1157,27 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::PyramidFilter(
     m_Timer.Start("6a) Image Resampler");
     imageResampler->Update();
     m_Timer.Stop("6a) Image Resampler");
+    this->SampleMemory();
   }
   catch (itk::ExceptionObject & exception)
   {
-    std::cerr << "ExceptionObject caught !" << std::endl;
-    std::cerr << exception << std::endl;
+    itkExceptionMacro(<< "PyramidFilter() failed: " << exception.GetDescription());
   }
 
   m_PatientImage = imageResampler->GetOutput();
   m_PatientImage->DisconnectPipeline();
 
+  if (m_UseDistanceMapErosion)
+  {
+    this->ResampleLevelSet(origin, extent, isoSpacing);
+    return;
+  }
 
   // resample mask
   using LabelResamplerType = itk::ResampleImageFilter<AtlasLabelType, AtlasLabelType>;
   typename LabelResamplerType::Pointer labelResampler = LabelResamplerType::New();
 
+  this->ConfigureInternalFilter(labelResampler);
   labelResampler->SetTransform(transform);
   labelResampler->SetInput(m_AtlasLabels);
 
@@ -672,17 +1186,14 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::PyramidFilter(
   labelSpacing[0] = isoSpacing;
   labelSpacing[1] = isoSpacing;
   labelSpacing[2] = isoSpacing;
-  labelSize[0] =
-    (this->GetInput()->GetLargestPossibleRegion().GetSize()[0]) * (this->GetInput()->GetSpacing()[0]) / labelSpacing[0];
-  labelSize[1] =
-    (this->GetInput()->GetLargestPossibleRegion().GetSize()[1]) * (this->GetInput()->GetSpacing()[1]) / labelSpacing[1];
-  labelSize[2] =
-    (this->GetInput()->GetLargestPossibleRegion().GetSize()[2]) * (this->GetInput()->GetSpacing()[2]) / labelSpacing[2];
+  labelSize[0] = extent[0] / labelSpacing[0];
+  labelSize[1] = extent[1] / labelSpacing[1];
+  labelSize[2] = extent[2] / labelSpacing[2];
 
   labelResampler->SetInterpolator(nnInterpolator);
   labelResampler->SetSize(labelSize);
   labelResampler->SetOutputSpacing(labelSpacing);
-  labelResampler->SetOutputOrigin(this->GetInput()->GetOrigin());
+  labelResampler->SetOutputOrigin(origin);
   labelResampler->SetOutputDirection(this->GetInput()->GetDirection());
   labelResampler->SetDefaultPixelValue(0);
 
@@ -692,11 +1203,11 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::PyramidFilter(
     m_Timer.Start("6b) Label Resampler");
     labelResampler->Update();
     m_Timer.Stop("6b) Label Resampler");
+    this->SampleMemory();
   }
   catch (itk::ExceptionObject & exception)
   {
-    std::cerr << "ExceptionObject caught !" << std::endl;
-    std::cerr << exception << std::endl;
+    itkExceptionMacro(<< "PyramidFilter() failed: " << exception.GetDescription());
   }
 
   m_AtlasLabels = labelResampler->GetOutput();
@@ -704,126 +1215,198 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::PyramidFilter(
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::LevelSetRefinement(int isoSpacing)
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::ResampleLevelSet(
+  const PointType &         origin,
+  const Vector<double, 3> & extent,
+  int                       isoSpacing)
 {
-  // refine brain mask using geodesic active contour level set evolution
+  // resample the signed distance map or the level set of the coarser
+  // resolution in place of the mask, linearly to keep the distances
+
+  // the seed replaces the mask, which is set again by the level set
+  m_AtlasLabels = nullptr;
+
+  using LevelSetResamplerType = itk::ResampleImageFilter<LevelSetImageType, LevelSetImageType>;
+  typename LevelSetResamplerType::Pointer levelSetResampler = LevelSetResamplerType::New();
+
+  using TransformType = itk::IdentityTransform<double, 3>;
+  typename TransformType::Pointer transform = TransformType::New();
+
+  using LinearInterpolatorType = itk::LinearInterpolateImageFunction<LevelSetImageType, double>;
+  typename LinearInterpolatorType::Pointer linearInterpolator = LinearInterpolatorType::New();
 
-  // have to cast images to float first for level-set
-  using FloatImageType = itk::Image<float, 3>;
+  transform->SetIdentity();
 
-  using ImageCasterType = itk::CastImageFilter<ImageType, FloatImageType>;
-  typename ImageCasterType::Pointer imageCaster = ImageCasterType::New();
+  typename LevelSetImageType::SpacingType levelSetSpacing;
+  typename LevelSetImageType::SizeType    levelSetSize;
+  for (unsigned int dim = 0; dim < 3; ++dim)
+  {
+    levelSetSpacing[dim] = isoSpacing;
+    levelSetSize[dim] = extent[dim] / levelSetSpacing[dim];
+  }
 
-  using LabelCasterType = itk::CastImageFilter<AtlasLabelType, FloatImageType>;
-  typename LabelCasterType::Pointer labelCaster = LabelCasterType::New();
+  this->ConfigureInternalFilter(levelSetResampler);
+  levelSetResampler->SetTransform(transform);
+  levelSetResampler->SetInput(m_LevelSet);
+  levelSetResampler->SetInterpolator(linearInterpolator);
+  levelSetResampler->SetSize(levelSetSize);
+  levelSetResampler->SetOutputSpacing(levelSetSpacing);
+  levelSetResampler->SetOutputOrigin(origin);
+  levelSetResampler->SetOutputDirection(this->GetInput()->GetDirection());
+  // outside of the seed, farther from the brain than any voxel of the resampled domain
+  levelSetResampler->SetDefaultPixelValue(static_cast<LevelSetPixelType>(-extent.GetNorm()));
 
-  imageCaster->SetInput(m_PatientImage);
-  labelCaster->SetInput(m_AtlasLabels);
   try
   {
-    m_Timer.Start("6c) Image Caster");
-    imageCaster->Update();
-    m_Timer.Stop("6c) Image Caster");
-    m_Timer.Start("6d) Label Caster");
-    labelCaster->Update();
-    m_Timer.Stop("6d) Label Caster");
+    m_Progress->RegisterInternalFilter(levelSetResampler, 0.01f);
+    m_Timer.Start("6b) Level Set Resampler");
+    levelSetResampler->Update();
+    m_Timer.Stop("6b) Level Set Resampler");
+    this->SampleMemory();
   }
-  catch (itk::ExceptionObject & excep)
+  catch (itk::ExceptionObject & exception)
   {
-    std::cerr << "Exception caught while doing GeodesicActiveContours !" << std::endl;
-    std::cerr << excep << std::endl;
+    itkExceptionMacro(<< "ResampleLevelSet() failed: " << exception.GetDescription());
   }
 
-  // Geodesic Active Contour level set settings
-  using SmoothingFilterType = itk::GradientAnisotropicDiffusionImageFilter<FloatImageType, FloatImageType>;
-  using GradientMagFilterType = itk::GradientMagnitudeRecursiveGaussianImageFilter<FloatImageType, FloatImageType>;
-  using RescalerType = itk::RescaleIntensityImageFilter<FloatImageType, FloatImageType>;
-  using SigmoidFilterType = itk::SigmoidImageFilter<FloatImageType, FloatImageType>;
-  using GeodesicActiveContourFilterType = itk::GeodesicActiveContourLevelSetImageFilter<FloatImageType, FloatImageType>;
-  typename SmoothingFilterType::Pointer             smoothingFilter = SmoothingFilterType::New();
-  typename GradientMagFilterType::Pointer           gradientMagnitude = GradientMagFilterType::New();
-  typename RescalerType::Pointer                    rescaler = RescalerType::New();
-  typename SigmoidFilterType::Pointer               sigmoid = SigmoidFilterType::New();
-  typename GeodesicActiveContourFilterType::Pointer geodesicActiveContour = GeodesicActiveContourFilterType::New();
+  m_LevelSet = levelSetResampler->GetOutput();
+  m_LevelSet->DisconnectPipeline();
+}
 
-  smoothingFilter->SetTimeStep(0.0625);
-  smoothingFilter->SetNumberOfIterations(5);
-  smoothingFilter->SetConductanceParameter(2.0);
 
-  gradientMagnitude->SetSigma(1.0);
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::LevelSetRefinement(int isoSpacing)
+{
+  // refine brain mask using geodesic active contour level set evolution
 
-  rescaler->SetOutputMinimum(0);
-  rescaler->SetOutputMaximum(255);
+  // initial level set, the resampled signed distance map or the mask cast to float
+  LevelSetImagePointer initialLevelSet = m_LevelSet;
+  m_LevelSet = nullptr;
 
-  sigmoid->SetOutputMinimum(0.0);
-  sigmoid->SetOutputMaximum(1.0);
+  if (!m_UseDistanceMapErosion)
+  {
+    // have to cast labels to float first for level-set
+    using LabelCasterType = itk::CastImageFilter<AtlasLabelType, LevelSetImageType>;
+    typename LabelCasterType::Pointer labelCaster = LabelCasterType::New();
 
+    this->ConfigureInternalFilter(labelCaster);
+    labelCaster->SetInput(m_AtlasLabels);
+    try
+    {
+      m_Timer.Start("6d) Label Caster");
+      labelCaster->Update();
+      m_Timer.Stop("6d) Label Caster");
+    }
+    catch (itk::ExceptionObject & excep)
+    {
+      itkExceptionMacro(<< "LevelSetRefinement() failed: " << excep.GetDescription());
+    }
 
-  geodesicActiveContour->SetIsoSurfaceValue(0.5);
-  geodesicActiveContour->SetUseImageSpacing(true);
+    initialLevelSet = labelCaster->GetOutput();
+    initialLevelSet->DisconnectPipeline();
+  }
 
-  // set parameters depending on coarse or fine isotropic resolution
-  if (isoSpacing == 2)
-  {
-    sigmoid->SetAlpha(-2.0);
-    sigmoid->SetBeta(12.0);
+  // in low memory mode each intermediate is freed once the next filter has consumed it
+  initialLevelSet->SetReleaseDataFlag(m_LowMemoryMode);
 
-    geodesicActiveContour->SetMaximumRMSError(0.01);
-    geodesicActiveContour->SetPropagationScaling(-2.0);
-    geodesicActiveContour->SetCurvatureScaling(10.0);
-    geodesicActiveContour->SetAdvectionScaling(2.0);
-    geodesicActiveContour->SetNumberOfIterations(100);
-  }
-  if (isoSpacing == 1)
+  // the mask is recomputed by the level set and the patient image is resampled
+  // from the input for the next resolution, only the smoothing reads it
+  if (m_LowMemoryMode)
   {
-    sigmoid->SetAlpha(-2.0);
-    sigmoid->SetBeta(12.0);
-
-    geodesicActiveContour->SetMaximumRMSError(0.001);
-    geodesicActiveContour->SetPropagationScaling(-1.0);
-    geodesicActiveContour->SetCurvatureScaling(20.0);
-    geodesicActiveContour->SetAdvectionScaling(5.0);
-    geodesicActiveContour->SetNumberOfIterations(120);
+    m_AtlasLabels = nullptr;
+    m_PatientImage->ReleaseDataFlagOn();
   }
 
-  m_Timer.Start("6e) Gradient AD");
-  smoothingFilter->SetInput(imageCaster->GetOutput());
-  smoothingFilter->Update();
-  m_Timer.Stop("6e) Gradient AD");
+  m_Timer.Start("6e) Feature Image");
+  LevelSetImagePointer featureImage = this->FeatureImage();
+  featureImage->SetReleaseDataFlag(m_LowMemoryMode);
+  m_Timer.Stop("6e) Feature Image");
 
-  m_Timer.Start("6f) Gradient Mag");
-  gradientMagnitude->SetInput(smoothingFilter->GetOutput());
-  gradientMagnitude->Update();
-  m_Timer.Stop("6f) Gradient Mag");
-
-  m_Timer.Start("6g) Rescaler");
-  rescaler->SetInput(gradientMagnitude->GetOutput());
-  rescaler->Update();
-  m_Timer.Stop("6g) Rescaler");
+  // the geodesic active contour only keeps its input, the feature image and its output
+  if (m_LowMemoryMode)
+  {
+    m_PatientImage = nullptr;
+  }
 
-  m_Timer.Start("6h) Sigmoid");
-  sigmoid->SetInput(rescaler->GetOutput());
-  sigmoid->Update();
-  m_Timer.Stop("6h) Sigmoid");
+  // same geodesic active contour, solved either on the sparse field or on a narrow band
+  LevelSetImagePointer levelSet;
 
   m_Timer.Start("6i) Geodesic");
-  geodesicActiveContour->SetInput(labelCaster->GetOutput());
-  geodesicActiveContour->SetFeatureImage(sigmoid->GetOutput());
-  geodesicActiveContour->Update();
+  if (m_UseNarrowBandLevelSet)
+  {
+    using NarrowBandFilterType =
+      itk::StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter<LevelSetImageType, LevelSetImageType>;
+    typename NarrowBandFilterType::Pointer narrowBand = NarrowBandFilterType::New();
+
+    this->ConfigureInternalFilter(narrowBand);
+    this->ConfigureLevelSet(narrowBand.GetPointer(), isoSpacing);
+    narrowBand->SetInput(initialLevelSet);
+    narrowBand->SetFeatureImage(featureImage);
+    try
+    {
+      narrowBand->Update();
+    }
+    catch (itk::ExceptionObject & excep)
+    {
+      itkExceptionMacro(<< "LevelSetRefinement() failed: " << excep.GetDescription());
+    }
+    m_CurrentStage.Iterations.push_back(narrowBand->GetElapsedIterations());
+    m_CurrentStage.RMSChanges.push_back(narrowBand->GetRMSChange());
+
+    levelSet = narrowBand->GetOutput();
+  }
+  else
+  {
+    using GeodesicActiveContourFilterType =
+      itk::GeodesicActiveContourLevelSetImageFilter<LevelSetImageType, LevelSetImageType>;
+    typename GeodesicActiveContourFilterType::Pointer geodesicActiveContour = GeodesicActiveContourFilterType::New();
+
+    this->ConfigureInternalFilter(geodesicActiveContour);
+    this->ConfigureLevelSet(geodesicActiveContour.GetPointer(), isoSpacing);
+    geodesicActiveContour->SetInput(initialLevelSet);
+    geodesicActiveContour->SetFeatureImage(featureImage);
+    try
+    {
+      geodesicActiveContour->Update();
+    }
+    catch (itk::ExceptionObject & excep)
+    {
+      itkExceptionMacro(<< "LevelSetRefinement() failed: " << excep.GetDescription());
+    }
+    m_CurrentStage.Iterations.push_back(geodesicActiveContour->GetElapsedIterations());
+    m_CurrentStage.RMSChanges.push_back(geodesicActiveContour->GetRMSChange());
+
+    levelSet = geodesicActiveContour->GetOutput();
+  }
+  levelSet->DisconnectPipeline();
+  // with distance map erosion the level set seeds the next resolution
+  if (m_UseDistanceMapErosion)
+  {
+    m_LevelSet = levelSet;
+  }
+  else
+  {
+    levelSet->SetReleaseDataFlag(m_LowMemoryMode);
+  }
   m_Timer.Stop("6i) Geodesic");
+  this->SampleMemory();
+  this->CountVoxels(levelSet);
 
-  // threshold level set output
-  using ThresholdFilterType = itk::BinaryThresholdImageFilter<FloatImageType, FloatImageType>;
+  // threshold level set output straight to the mask type,
+  // the narrow band keeps large values far from the contour
+  using ThresholdFilterType = itk::BinaryThresholdImageFilter<LevelSetImageType, AtlasLabelType>;
   typename ThresholdFilterType::Pointer thresholder = ThresholdFilterType::New();
 
+  this->ConfigureInternalFilter(thresholder);
   thresholder->SetUpperThreshold(0.0);
-  thresholder->SetLowerThreshold(-1000.0);
+  thresholder->SetLowerThreshold(NumericTraits<LevelSetPixelType>::NonpositiveMin());
   thresholder->SetOutsideValue(1);
   thresholder->SetInsideValue(0);
 
-  thresholder->SetInput(geodesicActiveContour->GetOutput());
+  thresholder->SetInput(levelSet);
   try
   {
     m_Progress->RegisterInternalFilter(thresholder, 0.01f);
@@ -833,41 +1416,126 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::LevelSetRefine
   }
   catch (itk::ExceptionObject & excep)
   {
-    std::cerr << "Exception caught while doing GeodesicActiveContours !" << std::endl;
-    std::cerr << excep << std::endl;
+    itkExceptionMacro(<< "LevelSetRefinement() failed: " << excep.GetDescription());
   }
 
+  m_AtlasLabels = thresholder->GetOutput();
+  m_AtlasLabels->DisconnectPipeline();
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+auto
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::FeatureImage() -> LevelSetImagePointer
+{
+  // speed image of the level set: edge preserving smoothing, gradient magnitude,
+  // then rescale and sigmoid in one pass over the gradient magnitude buffer;
+  // smoothing and gradient magnitude still write full volumes of their own
+
+  using SmoothingFilterType = itk::GradientAnisotropicDiffusionImageFilter<ImageType, LevelSetImageType>;
+  using GradientMagFilterType =
+    itk::GradientMagnitudeRecursiveGaussianImageFilter<LevelSetImageType, LevelSetImageType>;
+  using SigmoidFeatureFilterType = itk::StripTsSigmoidFeatureImageFilter<LevelSetImageType, LevelSetImageType>;
+  typename SmoothingFilterType::Pointer      smoothingFilter = SmoothingFilterType::New();
+  typename GradientMagFilterType::Pointer    gradientMagnitude = GradientMagFilterType::New();
+  typename SigmoidFeatureFilterType::Pointer sigmoidFeature = SigmoidFeatureFilterType::New();
+
+  this->ConfigureInternalFilter(smoothingFilter);
+  this->ConfigureInternalFilter(gradientMagnitude);
+  this->ConfigureInternalFilter(sigmoidFeature);
+
+  // the diffusion casts the patient image while copying it to its output
+  smoothingFilter->SetTimeStep(0.0625);
+  smoothingFilter->SetNumberOfIterations(5);
+  smoothingFilter->SetConductanceParameter(2.0);
+  smoothingFilter->SetInput(m_PatientImage);
+  smoothingFilter->ReleaseDataFlagOn();
+
+  gradientMagnitude->SetSigma(1.0);
+  gradientMagnitude->SetInput(smoothingFilter->GetOutput());
+
+  sigmoidFeature->SetRescaleMinimum(0);
+  sigmoidFeature->SetRescaleMaximum(255);
+  sigmoidFeature->SetOutputMinimum(0.0);
+  sigmoidFeature->SetOutputMaximum(1.0);
+  sigmoidFeature->InPlaceOn();
+  sigmoidFeature->SetInput(gradientMagnitude->GetOutput());
+
+  // same for the coarse and the fine isotropic resolution
+  sigmoidFeature->SetAlpha(-2.0);
+  sigmoidFeature->SetBeta(12.0);
 
-  // cast back mask from float to char
-  using LabelReCasterType = itk::CastImageFilter<FloatImageType, AtlasLabelType>;
-  typename LabelReCasterType::Pointer labelReCaster = LabelReCasterType::New();
+  // update step by step to sample the memory in use after each filter
+  const MemoryLoadType memoryBefore = this->SampleMemory();
+  MemoryLoadType       memoryPeak = memoryBefore;
 
-  labelReCaster->SetInput(thresholder->GetOutput());
   try
   {
-    m_Timer.Start("6k) Label Caster");
-    labelReCaster->Update();
-    m_Timer.Stop("6k) Label Caster");
+    smoothingFilter->Update();
+    memoryPeak = std::max(memoryPeak, this->SampleMemory());
+    gradientMagnitude->Update();
+    memoryPeak = std::max(memoryPeak, this->SampleMemory());
+    sigmoidFeature->Update();
+    memoryPeak = std::max(memoryPeak, this->SampleMemory());
   }
   catch (itk::ExceptionObject & excep)
   {
-    std::cerr << "Exception caught while doing GeodesicActiveContours !" << std::endl;
-    std::cerr << excep << std::endl;
+    itkExceptionMacro(<< "FeatureImage() failed: " << excep.GetDescription());
   }
 
-  m_AtlasLabels = labelReCaster->GetOutput();
-  m_AtlasLabels->DisconnectPipeline();
+  m_FeatureImageSampledPeakMemory = std::max(m_FeatureImageSampledPeakMemory, memoryPeak - memoryBefore);
+
+  LevelSetImagePointer featureImage = sigmoidFeature->GetOutput();
+  featureImage->DisconnectPipeline();
+  return featureImage;
 }
 
 
-template <class TImageType, class TAtlasImageType, class TAtlasLabelType>
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+template <typename TLevelSetFilter>
 void
-StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::UpsampleLabels()
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::ConfigureLevelSet(
+  TLevelSetFilter * levelSet,
+  int               isoSpacing) const
 {
-  // upsample atlas label image to original resolution
+  // geodesic active contour settings shared by sparse field and narrow band solver
+
+  // a binary mask has its boundary at 0.5, a signed distance map at 0
+  levelSet->SetIsoSurfaceValue(m_UseDistanceMapErosion ? 0.0 : 0.5);
+  levelSet->SetUseImageSpacing(true);
+
+  // set parameters depending on coarse or fine isotropic resolution
+  if (isoSpacing == 2)
+  {
+    levelSet->SetMaximumRMSError(0.01);
+    levelSet->SetPropagationScaling(-2.0);
+    levelSet->SetCurvatureScaling(10.0);
+    levelSet->SetAdvectionScaling(2.0);
+    levelSet->SetNumberOfIterations(100);
+  }
+  if (isoSpacing == 1)
+  {
+    levelSet->SetMaximumRMSError(0.001);
+    levelSet->SetPropagationScaling(-1.0);
+    levelSet->SetCurvatureScaling(20.0);
+    levelSet->SetAdvectionScaling(5.0);
+    levelSet->SetNumberOfIterations(120);
+  }
+}
+
+
+template <class TImageType, class TAtlasImageType, class TAtlasLabelType, class TWorkingTypes>
+void
+StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType, TWorkingTypes>::UpsampleLabels()
+{
+  // upsample atlas label image to original resolution, outside of a
+  // cropped brain region the mask is filled with background
 
   //  std::cout << "Generating final brain mask" << std::endl;
 
+  // the patient image is not used anymore
+  m_PatientImage = nullptr;
+
   using ResamplerType = itk::ResampleImageFilter<TAtlasLabelType, TAtlasLabelType>;
   typename ResamplerType::Pointer resampler = ResamplerType::New();
 
@@ -879,6 +1547,7 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::UpsampleLabels
 
   transform->SetIdentity();
 
+  this->ConfigureInternalFilter(resampler);
   resampler->SetTransform(transform);
   resampler->SetInput(m_AtlasLabels);
 
@@ -893,11 +1562,11 @@ StripTsImageFilter<TImageType, TAtlasImageType, TAtlasLabelType>::UpsampleLabels
   {
     m_Progress->RegisterInternalFilter(resampler, 0.01f);
     resampler->Update();
+    this->SampleMemory();
   }
   catch (itk::ExceptionObject & exception)
   {
-    std::cerr << "ExceptionObject caught !" << std::endl;
-    std::cerr << exception << std::endl;
+    itkExceptionMacro(<< "UpsampleLabels() failed: " << exception.GetDescription());
   }
 
   m_AtlasLabels = resampler->GetOutput();
@@ -0,0 +1,109 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsNarrowBandGeodesicActiveContourLevelSetImageFilter_h
+#define itkStripTsNarrowBandGeodesicActiveContourLevelSetImageFilter_h
+
+#include "itkNarrowBandLevelSetImageFilter.h"
+#include "itkGeodesicActiveContourLevelSetFunction.h"
+
+namespace itk
+{
+
+/** \class StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter
+ * \brief geodesic active contour evolved with the narrow band solver
+ *
+ * Same level set equation as GeodesicActiveContourLevelSetImageFilter
+ * (propagation, curvature and advection weighted by a feature image),
+ * but solved with NarrowBandLevelSetImageFilter instead of the sparse
+ * field solver. The sparse field solver updates its active layer in a
+ * single thread; the narrow band solver splits the band between the
+ * work units of the filter. Which one is faster depends on the image
+ * and the number of cores; itkStripTsImageFilterBenchmark times both.
+ *
+ * Both solvers only update voxels close to the zero level set. Their
+ * results are not identical: the narrow band is reinitialized
+ * periodically and its width is set with SetNarrowBandTotalRadius()
+ * and SetNarrowBandInnerRadius().
+ *
+ * \ingroup SkullStrip
+ */
+
+template <typename TInputImage, typename TFeatureImage, typename TOutputPixelType = float>
+class ITK_TEMPLATE_EXPORT StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter
+  : public NarrowBandLevelSetImageFilter<TInputImage,
+                                         TFeatureImage,
+                                         TOutputPixelType,
+                                         Image<TOutputPixelType, TInputImage::ImageDimension>>
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter);
+
+  // standard class type alias
+  using Self = StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter;
+  using Superclass = NarrowBandLevelSetImageFilter<TInputImage,
+                                                   TFeatureImage,
+                                                   TOutputPixelType,
+                                                   Image<TOutputPixelType, TInputImage::ImageDimension>>;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  // method for creation through the object factory
+  itkNewMacro(Self);
+
+  // run-time type information (and related methods)
+  itkTypeMacro(StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter, NarrowBandLevelSetImageFilter);
+
+  using ValueType = typename Superclass::ValueType;
+  using OutputImageType = typename Superclass::OutputImageType;
+  using FeatureImageType = typename Superclass::FeatureImageType;
+
+  using GeodesicActiveContourFunctionType = GeodesicActiveContourLevelSetFunction<OutputImageType, FeatureImageType>;
+  using GeodesicActiveContourFunctionPointer = typename GeodesicActiveContourFunctionType::Pointer;
+
+  // sigma of the derivative of the feature image used for the advection term
+  void
+  SetDerivativeSigma(float value);
+  float
+  GetDerivativeSigma() const
+  {
+    return m_GeodesicActiveContourFunction->GetDerivativeSigma();
+  }
+
+protected:
+  StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter();
+  ~StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter() override = default;
+
+  void
+  PrintSelf(std::ostream & os, Indent indent) const override;
+
+  void
+  GenerateData() override;
+
+private:
+  GeodesicActiveContourFunctionPointer m_GeodesicActiveContourFunction;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#  include "itkStripTsNarrowBandGeodesicActiveContourLevelSetImageFilter.hxx"
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsNarrowBandGeodesicActiveContourLevelSetImageFilter_hxx
+#define itkStripTsNarrowBandGeodesicActiveContourLevelSetImageFilter_hxx
+
+
+namespace itk
+{
+
+template <class TInputImage, class TFeatureImage, class TOutputPixelType>
+StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter<TInputImage, TFeatureImage, TOutputPixelType>::
+  StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter()
+{
+  // constructor
+  m_GeodesicActiveContourFunction = GeodesicActiveContourFunctionType::New();
+  this->SetSegmentationFunction(m_GeodesicActiveContourFunction);
+}
+
+
+template <class TInputImage, class TFeatureImage, class TOutputPixelType>
+void
+StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter<TInputImage, TFeatureImage, TOutputPixelType>::
+  SetDerivativeSigma(float value)
+{
+  if (Math::NotExactlyEquals(value, m_GeodesicActiveContourFunction->GetDerivativeSigma()))
+  {
+    m_GeodesicActiveContourFunction->SetDerivativeSigma(value);
+    this->Modified();
+  }
+}
+
+
+template <class TInputImage, class TFeatureImage, class TOutputPixelType>
+void
+StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter<TInputImage, TFeatureImage, TOutputPixelType>::GenerateData()
+{
+  // the speed image is needed even when propagation is switched off
+  if (this->GetSegmentationFunction() &&
+      Math::ExactlyEquals(this->GetSegmentationFunction()->GetPropagationWeight(), 0))
+  {
+    this->GetSegmentationFunction()->AllocateSpeedImage();
+    this->GetSegmentationFunction()->CalculateSpeedImage();
+  }
+
+  Superclass::GenerateData();
+}
+
+
+template <class TInputImage, class TFeatureImage, class TOutputPixelType>
+void
+StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter<TInputImage, TFeatureImage, TOutputPixelType>::PrintSelf(
+  std::ostream & os,
+  Indent         indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  itkPrintSelfObjectMacro(GeodesicActiveContourFunction);
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,92 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsPrecomputedPyramidImageFilter_h
+#define itkStripTsPrecomputedPyramidImageFilter_h
+
+#include "itkMultiResolutionPyramidImageFilter.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class StripTsPrecomputedPyramidImageFilter
+ * \brief multi-resolution pyramid that hands out already computed levels
+ *
+ * Drop-in replacement for the pyramid used inside
+ * MultiResolutionImageRegistrationMethod. Instead of smoothing and
+ * subsampling its input, the filter grafts images that were computed
+ * beforehand (e.g. by StripTsPreparedAtlas) onto its outputs, so an atlas
+ * pyramid can be shared by many registrations.
+ *
+ * The level images are only read, never modified, and have to match the
+ * regions the schedule of this filter produces for its input.
+ *
+ * \ingroup SkullStrip
+ */
+
+template <typename TInputImage, typename TOutputImage>
+class ITK_TEMPLATE_EXPORT StripTsPrecomputedPyramidImageFilter
+  : public MultiResolutionPyramidImageFilter<TInputImage, TOutputImage>
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(StripTsPrecomputedPyramidImageFilter);
+
+  // standard class type alias
+  using Self = StripTsPrecomputedPyramidImageFilter;
+  using Superclass = MultiResolutionPyramidImageFilter<TInputImage, TOutputImage>;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  // method for creation through the object factory
+  itkNewMacro(Self);
+
+  // run-time type information (and related methods)
+  itkTypeMacro(StripTsPrecomputedPyramidImageFilter, MultiResolutionPyramidImageFilter);
+
+  using OutputImageType = typename Superclass::OutputImageType;
+  using OutputImageConstPointer = typename OutputImageType::ConstPointer;
+
+  // set the precomputed image of one pyramid level (0 is the coarsest)
+  void
+  SetLevelImage(unsigned int level, const OutputImageType * image);
+
+protected:
+  StripTsPrecomputedPyramidImageFilter() = default;
+  ~StripTsPrecomputedPyramidImageFilter() override = default;
+
+  void
+  PrintSelf(std::ostream & os, Indent indent) const override;
+
+  // graft the precomputed levels onto the outputs
+  void
+  GenerateData() override;
+
+private:
+  std::vector<OutputImageConstPointer> m_LevelImages;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#  include "itkStripTsPrecomputedPyramidImageFilter.hxx"
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsPrecomputedPyramidImageFilter_hxx
+#define itkStripTsPrecomputedPyramidImageFilter_hxx
+
+
+namespace itk
+{
+
+template <class TInputImage, class TOutputImage>
+void
+StripTsPrecomputedPyramidImageFilter<TInputImage, TOutputImage>::SetLevelImage(unsigned int            level,
+                                                                               const OutputImageType * image)
+{
+  if (level >= m_LevelImages.size())
+  {
+    m_LevelImages.resize(level + 1);
+  }
+
+  if (m_LevelImages[level] != image)
+  {
+    m_LevelImages[level] = image;
+    this->Modified();
+  }
+}
+
+
+template <class TInputImage, class TOutputImage>
+void
+StripTsPrecomputedPyramidImageFilter<TInputImage, TOutputImage>::GenerateData()
+{
+  for (unsigned int ilevel = 0; ilevel < this->GetNumberOfLevels(); ++ilevel)
+  {
+    if (ilevel >= m_LevelImages.size() || m_LevelImages[ilevel].IsNull())
+    {
+      itkExceptionMacro(<< "No precomputed image for pyramid level " << ilevel);
+    }
+
+    OutputImageType * output = this->GetOutput(ilevel);
+    if (m_LevelImages[ilevel]->GetLargestPossibleRegion() != output->GetLargestPossibleRegion())
+    {
+      itkExceptionMacro(<< "Precomputed image for pyramid level " << ilevel << " does not match the schedule");
+    }
+
+    // the level images are shared read-only, grafting only hands out their buffers
+    this->GraftNthOutput(ilevel, const_cast<OutputImageType *>(m_LevelImages[ilevel].GetPointer()));
+  }
+}
+
+
+template <class TInputImage, class TOutputImage>
+void
+StripTsPrecomputedPyramidImageFilter<TInputImage, TOutputImage>::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "Number of precomputed levels: " << m_LevelImages.size() << std::endl;
+}
+
+} // end namespace itk
+
+#endif
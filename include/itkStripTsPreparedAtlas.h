@@ -0,0 +1,176 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsPreparedAtlas_h
+#define itkStripTsPreparedAtlas_h
+
+#include "itkObject.h"
+#include "itkImage.h"
+#include "itkStripTsPrecomputedPyramidImageFilter.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class StripTsPreparedAtlas
+ * \brief atlas preprocessed once for use by many StripTsImageFilter runs
+ *
+ * Holds everything StripTsImageFilter derives from the atlas alone:
+ * the atlas image rescaled to 0-255, the levels of the multi-resolution
+ * pyramid used by the registration and the binarized brain mask. The
+ * rescaled image and the pyramid levels are stored as TWorkingImageType,
+ * the atlas registration image type of the filter using the atlas.
+ *
+ * It requires 2 inputs:
+ * SetAtlasImage()
+ * SetAtlasBrainMask()
+ * followed by a call to Prepare(). Alternatively a prepared atlas can be
+ * stored with Write() and loaded again with Read(). The pyramid schedule
+ * is stored with the images; Read() restores it and throws an exception
+ * when the stored levels do not match it, leaving the atlas unchanged.
+ *
+ * Pass it to StripTsImageFilter::SetPreparedAtlas() in place of
+ * SetAtlasImage()/SetAtlasBrainMask(). The prepared images are never
+ * modified by the filter, so one prepared atlas can be shared by
+ * several filters, also when they run concurrently.
+ *
+ * \ingroup SkullStrip
+ */
+
+template <typename TAtlasImageType,
+          typename TAtlasLabelType = Image<unsigned char, TAtlasImageType::ImageDimension>,
+          typename TWorkingImageType = TAtlasImageType>
+class ITK_TEMPLATE_EXPORT StripTsPreparedAtlas : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(StripTsPreparedAtlas);
+
+  // standard class type alias
+  using Self = StripTsPreparedAtlas;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  // method for creation through the object factory
+  itkNewMacro(Self);
+
+  // run-time type information (and related methods)
+  itkTypeMacro(StripTsPreparedAtlas, Object);
+
+  // display
+  void
+  PrintSelf(std::ostream & os, Indent indent) const override;
+
+  // image and label templates
+  using AtlasImageType = TAtlasImageType;
+  using AtlasImagePointer = typename AtlasImageType::Pointer;
+  using AtlasImageConstPointer = typename AtlasImageType::ConstPointer;
+
+  using AtlasLabelType = TAtlasLabelType;
+  using AtlasLabelPointer = typename AtlasLabelType::Pointer;
+  using AtlasLabelConstPointer = typename AtlasLabelType::ConstPointer;
+
+  using WorkingImageType = TWorkingImageType;
+  using WorkingImagePointer = typename WorkingImageType::Pointer;
+
+  using MovingImagePyramidType = StripTsPrecomputedPyramidImageFilter<WorkingImageType, WorkingImageType>;
+  using MovingImagePyramidPointer = typename MovingImagePyramidType::Pointer;
+  using ScheduleType = typename MovingImagePyramidType::ScheduleType;
+
+  void
+  SetAtlasImage(const TAtlasImageType * ptr);
+  void
+  SetAtlasBrainMask(const TAtlasLabelType * ptr);
+
+  // rescale the atlas, build its pyramid levels and binarize the brain mask
+  void
+  Prepare();
+
+  // true once Prepare() or Read() succeeded
+  bool
+  IsPrepared() const;
+
+  // atlas image rescaled to 0-255
+  const WorkingImageType *
+  GetAtlasImage() const
+  {
+    return m_AtlasImage.GetPointer();
+  }
+
+  // brain mask with all non-zero labels set to 1
+  const AtlasLabelType *
+  GetAtlasLabels() const
+  {
+    return m_AtlasLabels.GetPointer();
+  }
+
+  // shrink factors of the registration pyramid, one row per level
+  const ScheduleType &
+  GetSchedule() const
+  {
+    return m_Schedule;
+  }
+
+  unsigned int
+  GetNumberOfLevels() const
+  {
+    return m_Schedule.rows();
+  }
+
+  const WorkingImageType *
+  GetPyramidLevel(unsigned int level) const;
+
+#if !defined(ITK_WRAPPING_PARSER)
+  // new pyramid filter handing out the prepared levels, one per registration
+  MovingImagePyramidPointer
+  CreateMovingImagePyramid() const;
+#endif
+
+  // store the prepared images as <prefix>Image.mha, <prefix>Mask.mha and <prefix>Level<n>.mha,
+  // the schedule as <prefix>Schedule.txt
+  void
+  Write(const std::string & prefix) const;
+
+  // load images and schedule stored by Write()
+  void
+  Read(const std::string & prefix);
+
+protected:
+  StripTsPreparedAtlas();
+  ~StripTsPreparedAtlas() override = default;
+
+private:
+  AtlasImageConstPointer           m_InputAtlasImage;
+  AtlasLabelConstPointer           m_InputAtlasLabels;
+  WorkingImagePointer              m_AtlasImage;
+  AtlasLabelPointer                m_AtlasLabels;
+  std::vector<WorkingImagePointer> m_PyramidLevels;
+  ScheduleType                     m_Schedule;
+
+}; // end of class
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#  include "itkStripTsPreparedAtlas.hxx"
+#endif
+
+#endif
@@ -0,0 +1,330 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsPreparedAtlas_hxx
+#define itkStripTsPreparedAtlas_hxx
+
+#include "itkRescaleIntensityImageFilter.h"
+#include "itkMultiResolutionPyramidImageFilter.h"
+#include "itkBinaryThresholdImageFilter.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace itk
+{
+
+template <class TAtlasImageType, class TAtlasLabelType, class TWorkingImageType>
+StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, TWorkingImageType>::StripTsPreparedAtlas()
+{
+  // constructor
+
+  // registration runs on 4x and 2x subsampled images for speed gains
+  m_Schedule.SetSize(2, AtlasImageType::ImageDimension);
+  for (unsigned int dim = 0; dim < AtlasImageType::ImageDimension; ++dim)
+  {
+    m_Schedule[0][dim] = 4;
+    m_Schedule[1][dim] = 2;
+  }
+}
+
+
+template <class TAtlasImageType, class TAtlasLabelType, class TWorkingImageType>
+void
+StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, TWorkingImageType>::PrintSelf(std::ostream & os,
+                                                                                     Indent         indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "Prepared: " << (this->IsPrepared() ? "true" : "false") << std::endl;
+  os << indent << "Schedule: " << std::endl << m_Schedule << std::endl;
+}
+
+
+template <class TAtlasImageType, class TAtlasLabelType, class TWorkingImageType>
+void
+StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, TWorkingImageType>::SetAtlasImage(const TAtlasImageType * ptr)
+{
+  m_InputAtlasImage = ptr;
+  this->Modified();
+}
+
+
+template <class TAtlasImageType, class TAtlasLabelType, class TWorkingImageType>
+void
+StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, TWorkingImageType>::SetAtlasBrainMask(
+  const TAtlasLabelType * ptr)
+{
+  m_InputAtlasLabels = ptr;
+  this->Modified();
+}
+
+
+template <class TAtlasImageType, class TAtlasLabelType, class TWorkingImageType>
+bool
+StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, TWorkingImageType>::IsPrepared() const
+{
+  return m_AtlasImage.IsNotNull() && m_AtlasLabels.IsNotNull() && m_PyramidLevels.size() == m_Schedule.rows();
+}
+
+
+template <class TAtlasImageType, class TAtlasLabelType, class TWorkingImageType>
+void
+StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, TWorkingImageType>::Prepare()
+{
+  if (m_InputAtlasImage.IsNull() || m_InputAtlasLabels.IsNull())
+  {
+    itkExceptionMacro(<< "Atlas image and atlas brain mask have to be set before preparing the atlas");
+  }
+
+  // rescale atlas image intensities to 0-255, straight into the working type
+  using RescalerType = itk::RescaleIntensityImageFilter<AtlasImageType, WorkingImageType>;
+  typename RescalerType::Pointer rescaler = RescalerType::New();
+
+  rescaler->SetInput(m_InputAtlasImage);
+  rescaler->SetOutputMinimum(0);
+  rescaler->SetOutputMaximum(255);
+  rescaler->Update();
+
+  m_AtlasImage = rescaler->GetOutput();
+  m_AtlasImage->DisconnectPipeline();
+
+  // same pyramid the registration method would build for the moving image
+  using PyramidType = itk::MultiResolutionPyramidImageFilter<WorkingImageType, WorkingImageType>;
+  typename PyramidType::Pointer pyramid = PyramidType::New();
+
+  pyramid->SetNumberOfLevels(m_Schedule.rows());
+  pyramid->SetSchedule(m_Schedule);
+  pyramid->SetInput(m_AtlasImage);
+  pyramid->UpdateLargestPossibleRegion();
+
+  m_PyramidLevels.resize(m_Schedule.rows());
+  for (unsigned int level = 0; level < m_Schedule.rows(); ++level)
+  {
+    m_PyramidLevels[level] = pyramid->GetOutput(level);
+    m_PyramidLevels[level]->DisconnectPipeline();
+  }
+
+  // make sure mask is binary
+  using ThresholderType = itk::BinaryThresholdImageFilter<AtlasLabelType, AtlasLabelType>;
+  typename ThresholderType::Pointer thresholder = ThresholderType::New();
+
+  thresholder->SetInput(m_InputAtlasLabels);
+  thresholder->SetLowerThreshold(0);
+  thresholder->SetUpperThreshold(0);
+  thresholder->SetInsideValue(0);
+  thresholder->SetOutsideValue(1);
+  thresholder->Update();
+
+  m_AtlasLabels = thresholder->GetOutput();
+  m_AtlasLabels->DisconnectPipeline();
+}
+
+
+template <class TAtlasImageType, class TAtlasLabelType, class TWorkingImageType>
+auto
+StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, TWorkingImageType>::GetPyramidLevel(unsigned int level) const
+  -> const WorkingImageType *
+{
+  if (level >= m_PyramidLevels.size())
+  {
+    itkExceptionMacro(<< "Pyramid level " << level << " has not been prepared");
+  }
+  return m_PyramidLevels[level].GetPointer();
+}
+
+
+#if !defined(ITK_WRAPPING_PARSER)
+template <class TAtlasImageType, class TAtlasLabelType, class TWorkingImageType>
+auto
+StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, TWorkingImageType>::CreateMovingImagePyramid() const
+  -> MovingImagePyramidPointer
+{
+  if (!this->IsPrepared())
+  {
+    itkExceptionMacro(<< "Atlas has not been prepared");
+  }
+
+  MovingImagePyramidPointer pyramid = MovingImagePyramidType::New();
+  for (unsigned int level = 0; level < m_PyramidLevels.size(); ++level)
+  {
+    pyramid->SetLevelImage(level, m_PyramidLevels[level]);
+  }
+  return pyramid;
+}
+#endif
+
+
+template <class TAtlasImageType, class TAtlasLabelType, class TWorkingImageType>
+void
+StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, TWorkingImageType>::Write(const std::string & prefix) const
+{
+  if (!this->IsPrepared())
+  {
+    itkExceptionMacro(<< "Atlas has not been prepared");
+  }
+
+  using ImageWriterType = itk::ImageFileWriter<WorkingImageType>;
+  typename ImageWriterType::Pointer imageWriter = ImageWriterType::New();
+  imageWriter->SetUseCompression(true);
+
+  imageWriter->SetInput(m_AtlasImage);
+  imageWriter->SetFileName(prefix + "Image.mha");
+  imageWriter->Update();
+
+  for (unsigned int level = 0; level < m_PyramidLevels.size(); ++level)
+  {
+    std::ostringstream fileName;
+    fileName << prefix << "Level" << level << ".mha";
+
+    imageWriter->SetInput(m_PyramidLevels[level]);
+    imageWriter->SetFileName(fileName.str());
+    imageWriter->Update();
+  }
+
+  using LabelWriterType = itk::ImageFileWriter<AtlasLabelType>;
+  typename LabelWriterType::Pointer labelWriter = LabelWriterType::New();
+  labelWriter->SetUseCompression(true);
+
+  labelWriter->SetInput(m_AtlasLabels);
+  labelWriter->SetFileName(prefix + "Mask.mha");
+  labelWriter->Update();
+
+  // shrink factors the levels were built with, one line per level
+  const std::string scheduleFileName = prefix + "Schedule.txt";
+  std::ofstream     scheduleFile(scheduleFileName);
+  for (unsigned int level = 0; level < m_Schedule.rows(); ++level)
+  {
+    for (unsigned int dim = 0; dim < m_Schedule.cols(); ++dim)
+    {
+      scheduleFile << (dim > 0 ? " " : "") << m_Schedule[level][dim];
+    }
+    scheduleFile << std::endl;
+  }
+  if (!scheduleFile)
+  {
+    itkExceptionMacro(<< "Could not write the pyramid schedule to " << scheduleFileName);
+  }
+}
+
+
+template <class TAtlasImageType, class TAtlasLabelType, class TWorkingImageType>
+void
+StripTsPreparedAtlas<TAtlasImageType, TAtlasLabelType, TWorkingImageType>::Read(const std::string & prefix)
+{
+  // everything is read and checked first, the atlas is only changed once all of it is valid
+
+  // schedule stored by Write(), one line of shrink factors per level
+  const std::string scheduleFileName = prefix + "Schedule.txt";
+  std::ifstream     scheduleFile(scheduleFileName);
+  if (!scheduleFile)
+  {
+    itkExceptionMacro(<< "Could not read the pyramid schedule from " << scheduleFileName);
+  }
+
+  std::vector<std::string> scheduleLines;
+  std::string              line;
+  while (std::getline(scheduleFile, line))
+  {
+    if (!line.empty())
+    {
+      scheduleLines.push_back(line);
+    }
+  }
+  if (scheduleLines.empty())
+  {
+    itkExceptionMacro(<< "Pyramid schedule " << scheduleFileName << " has no levels");
+  }
+
+  ScheduleType schedule;
+  schedule.SetSize(scheduleLines.size(), WorkingImageType::ImageDimension);
+  for (unsigned int level = 0; level < schedule.rows(); ++level)
+  {
+    std::istringstream lineStream(scheduleLines[level]);
+    for (unsigned int dim = 0; dim < schedule.cols(); ++dim)
+    {
+      lineStream >> schedule[level][dim];
+      if (lineStream.fail() || schedule[level][dim] < 1)
+      {
+        itkExceptionMacro(<< "Level " << level << " of the pyramid schedule " << scheduleFileName
+                          << " needs " << schedule.cols() << " shrink factors of at least 1");
+      }
+    }
+  }
+
+  using ImageReaderType = itk::ImageFileReader<WorkingImageType>;
+  typename ImageReaderType::Pointer imageReader = ImageReaderType::New();
+  imageReader->SetFileName(prefix + "Image.mha");
+  imageReader->Update();
+
+  WorkingImagePointer atlasImage = imageReader->GetOutput();
+  atlasImage->DisconnectPipeline();
+
+  const typename WorkingImageType::RegionType atlasRegion = atlasImage->GetLargestPossibleRegion();
+
+  std::vector<WorkingImagePointer> pyramidLevels(schedule.rows());
+  for (unsigned int level = 0; level < schedule.rows(); ++level)
+  {
+    std::ostringstream fileName;
+    fileName << prefix << "Level" << level << ".mha";
+
+    typename ImageReaderType::Pointer levelReader = ImageReaderType::New();
+    levelReader->SetFileName(fileName.str());
+    levelReader->Update();
+
+    pyramidLevels[level] = levelReader->GetOutput();
+    pyramidLevels[level]->DisconnectPipeline();
+
+    // region MultiResolutionPyramidImageFilter computes for the level from the atlas image
+    typename WorkingImageType::RegionType expectedRegion;
+    for (unsigned int dim = 0; dim < schedule.cols(); ++dim)
+    {
+      const double        shrinkFactor = static_cast<double>(schedule[level][dim]);
+      const SizeValueType levelSize = static_cast<SizeValueType>(std::floor(atlasRegion.GetSize(dim) / shrinkFactor));
+      expectedRegion.SetSize(dim, std::max<SizeValueType>(levelSize, 1));
+      expectedRegion.SetIndex(dim, static_cast<IndexValueType>(std::ceil(atlasRegion.GetIndex(dim) / shrinkFactor)));
+    }
+    if (pyramidLevels[level]->GetLargestPossibleRegion() != expectedRegion)
+    {
+      itkExceptionMacro(<< fileName.str() << " does not match level " << level << " of the pyramid schedule "
+                        << scheduleFileName << " and " << prefix << "Image.mha");
+    }
+  }
+
+  using LabelReaderType = itk::ImageFileReader<AtlasLabelType>;
+  typename LabelReaderType::Pointer labelReader = LabelReaderType::New();
+  labelReader->SetFileName(prefix + "Mask.mha");
+  labelReader->Update();
+
+  m_AtlasImage = atlasImage;
+  m_PyramidLevels = pyramidLevels;
+  m_Schedule = schedule;
+  m_AtlasLabels = labelReader->GetOutput();
+  m_AtlasLabels->DisconnectPipeline();
+
+  this->Modified();
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,116 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsSigmoidFeatureImageFilter_h
+#define itkStripTsSigmoidFeatureImageFilter_h
+
+#include "itkInPlaceImageFilter.h"
+
+namespace itk
+{
+
+/** \class StripTsSigmoidFeatureImageFilter
+ * \brief rescale and sigmoid mapping fused into a single pass
+ *
+ * Computes the same values as a RescaleIntensityImageFilter (to
+ * RescaleMinimum-RescaleMaximum, with a float intermediate) followed by
+ * a SigmoidImageFilter (Alpha, Beta, OutputMinimum-OutputMaximum), but
+ * visits every voxel only once. After the input range is determined the
+ * requested region is processed in independent chunks, one per work
+ * unit, and when running in place no buffer besides the input is used.
+ *
+ * StripTsImageFilter uses it to turn the gradient magnitude of the
+ * patient image into the feature image of the level set.
+ *
+ * \ingroup SkullStrip
+ */
+
+template <typename TInputImage, typename TOutputImage = TInputImage>
+class ITK_TEMPLATE_EXPORT StripTsSigmoidFeatureImageFilter : public InPlaceImageFilter<TInputImage, TOutputImage>
+{
+public:
+  ITK_DISALLOW_COPY_AND_MOVE(StripTsSigmoidFeatureImageFilter);
+
+  // standard class type alias
+  using Self = StripTsSigmoidFeatureImageFilter;
+  using Superclass = InPlaceImageFilter<TInputImage, TOutputImage>;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  // method for creation through the object factory
+  itkNewMacro(Self);
+
+  // run-time type information (and related methods)
+  itkTypeMacro(StripTsSigmoidFeatureImageFilter, InPlaceImageFilter);
+
+  using InputImageType = TInputImage;
+  using InputPixelType = typename InputImageType::PixelType;
+  using OutputImageType = TOutputImage;
+  using OutputPixelType = typename OutputImageType::PixelType;
+  using OutputImageRegionType = typename OutputImageType::RegionType;
+  using RealType = typename NumericTraits<InputPixelType>::RealType;
+
+  // range the input intensities are rescaled to before the sigmoid
+  itkSetMacro(RescaleMinimum, InputPixelType);
+  itkGetConstMacro(RescaleMinimum, InputPixelType);
+  itkSetMacro(RescaleMaximum, InputPixelType);
+  itkGetConstMacro(RescaleMaximum, InputPixelType);
+
+  // sigmoid parameters, see SigmoidImageFilter
+  itkSetMacro(Alpha, double);
+  itkGetConstMacro(Alpha, double);
+  itkSetMacro(Beta, double);
+  itkGetConstMacro(Beta, double);
+  itkSetMacro(OutputMinimum, OutputPixelType);
+  itkGetConstMacro(OutputMinimum, OutputPixelType);
+  itkSetMacro(OutputMaximum, OutputPixelType);
+  itkGetConstMacro(OutputMaximum, OutputPixelType);
+
+protected:
+  StripTsSigmoidFeatureImageFilter();
+  ~StripTsSigmoidFeatureImageFilter() override = default;
+
+  void
+  PrintSelf(std::ostream & os, Indent indent) const override;
+
+  // determine the input range and the rescale factor
+  void
+  BeforeThreadedGenerateData() override;
+
+  void
+  DynamicThreadedGenerateData(const OutputImageRegionType & outputRegionForThread) override;
+
+private:
+  InputPixelType  m_RescaleMinimum;
+  InputPixelType  m_RescaleMaximum;
+  double          m_Alpha{ 1.0 };
+  double          m_Beta{ 0.0 };
+  OutputPixelType m_OutputMinimum;
+  OutputPixelType m_OutputMaximum;
+  RealType        m_Scale{ 1.0 };
+  RealType        m_Shift{ 0.0 };
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#  include "itkStripTsSigmoidFeatureImageFilter.hxx"
+#endif
+
+#endif
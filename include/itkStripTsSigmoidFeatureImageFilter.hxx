@@ -0,0 +1,138 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsSigmoidFeatureImageFilter_hxx
+#define itkStripTsSigmoidFeatureImageFilter_hxx
+
+#include "itkMinimumMaximumImageCalculator.h"
+#include "itkImageScanlineConstIterator.h"
+#include "itkImageScanlineIterator.h"
+#include "itkTotalProgressReporter.h"
+
+#include <cmath>
+
+namespace itk
+{
+
+template <class TInputImage, class TOutputImage>
+StripTsSigmoidFeatureImageFilter<TInputImage, TOutputImage>::StripTsSigmoidFeatureImageFilter()
+{
+  // constructor
+  m_RescaleMinimum = NumericTraits<InputPixelType>::ZeroValue();
+  m_RescaleMaximum = static_cast<InputPixelType>(255);
+  m_OutputMinimum = NumericTraits<OutputPixelType>::ZeroValue();
+  m_OutputMaximum = NumericTraits<OutputPixelType>::OneValue();
+
+  this->InPlaceOn();
+}
+
+
+template <class TInputImage, class TOutputImage>
+void
+StripTsSigmoidFeatureImageFilter<TInputImage, TOutputImage>::BeforeThreadedGenerateData()
+{
+  // same factor and offset as RescaleIntensityImageFilter
+  using CalculatorType = MinimumMaximumImageCalculator<InputImageType>;
+  typename CalculatorType::Pointer calculator = CalculatorType::New();
+
+  calculator->SetImage(this->GetInput());
+  calculator->SetRegion(this->GetInput()->GetRequestedRegion());
+  calculator->Compute();
+
+  const RealType inputMinimum = static_cast<RealType>(calculator->GetMinimum());
+  const RealType inputMaximum = static_cast<RealType>(calculator->GetMaximum());
+  const RealType outputRange = static_cast<RealType>(m_RescaleMaximum) - static_cast<RealType>(m_RescaleMinimum);
+
+  if (Math::NotAlmostEquals(inputMinimum, inputMaximum))
+  {
+    m_Scale = outputRange / (inputMaximum - inputMinimum);
+  }
+  else if (Math::NotAlmostEquals(inputMaximum, NumericTraits<RealType>::ZeroValue()))
+  {
+    m_Scale = outputRange / inputMaximum;
+  }
+  else
+  {
+    m_Scale = 0.0;
+  }
+  m_Shift = static_cast<RealType>(m_RescaleMinimum) - inputMinimum * m_Scale;
+}
+
+
+template <class TInputImage, class TOutputImage>
+void
+StripTsSigmoidFeatureImageFilter<TInputImage, TOutputImage>::DynamicThreadedGenerateData(
+  const OutputImageRegionType & outputRegionForThread)
+{
+  const InputImageType * input = this->GetInput();
+  OutputImageType *      output = this->GetOutput();
+
+  TotalProgressReporter progress(this, output->GetRequestedRegion().GetNumberOfPixels());
+
+  ImageScanlineConstIterator<InputImageType> inputIt(input, outputRegionForThread);
+  ImageScanlineIterator<OutputImageType>     outputIt(output, outputRegionForThread);
+
+  while (!inputIt.IsAtEnd())
+  {
+    while (!inputIt.IsAtEndOfLine())
+    {
+      // rescale, clamped and rounded to the pixel type as an intermediate image would be
+      InputPixelType rescaled = static_cast<InputPixelType>(static_cast<RealType>(inputIt.Get()) * m_Scale + m_Shift);
+      rescaled = (rescaled > m_RescaleMaximum) ? m_RescaleMaximum : rescaled;
+      rescaled = (rescaled < m_RescaleMinimum) ? m_RescaleMinimum : rescaled;
+
+      // sigmoid
+      const double x = (static_cast<double>(rescaled) - m_Beta) / m_Alpha;
+      const double e = 1.0 / (1.0 + std::exp(-x));
+      const double v = (m_OutputMaximum - m_OutputMinimum) * e + m_OutputMinimum;
+      outputIt.Set(static_cast<OutputPixelType>(v));
+
+      ++inputIt;
+      ++outputIt;
+    }
+    progress.Completed(outputRegionForThread.GetSize()[0]);
+    inputIt.NextLine();
+    outputIt.NextLine();
+  }
+}
+
+
+template <class TInputImage, class TOutputImage>
+void
+StripTsSigmoidFeatureImageFilter<TInputImage, TOutputImage>::PrintSelf(std::ostream & os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+
+  os << indent << "RescaleMinimum: " << static_cast<typename NumericTraits<InputPixelType>::PrintType>(m_RescaleMinimum)
+     << std::endl;
+  os << indent << "RescaleMaximum: " << static_cast<typename NumericTraits<InputPixelType>::PrintType>(m_RescaleMaximum)
+     << std::endl;
+  os << indent << "Alpha: " << m_Alpha << std::endl;
+  os << indent << "Beta: " << m_Beta << std::endl;
+  os << indent << "OutputMinimum: " << static_cast<typename NumericTraits<OutputPixelType>::PrintType>(m_OutputMinimum)
+     << std::endl;
+  os << indent << "OutputMaximum: " << static_cast<typename NumericTraits<OutputPixelType>::PrintType>(m_OutputMaximum)
+     << std::endl;
+  os << indent << "Scale: " << m_Scale << std::endl;
+  os << indent << "Shift: " << m_Shift << std::endl;
+}
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,85 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef itkStripTsStageMetrics_h
+#define itkStripTsStageMetrics_h
+
+#include "itkEventObject.h"
+#include "itkIntTypes.h"
+#include "SkullStripExport.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \struct StripTsStageMetrics
+ * \brief performance figures of one stage of StripTsImageFilter
+ *
+ * Times are in seconds, CPUTime is the processor time of the whole
+ * process (all threads) spent during the stage. SampledPeakMemory is the
+ * largest memory use of the process sampled during the stage, in kB;
+ * memory allocated and freed between two samples is not seen.
+ *
+ * CPUTime and SampledPeakMemory are measured for the whole process. When
+ * other work runs in the same process, e.g. the concurrent subjects of
+ * StripTsBatchProcessor, they include that work and are not valid for
+ * the stage; WallTime and the remaining values still are.
+ * NumberOfVoxels counts the voxels of the images the stage produced or
+ * registered.
+ *
+ * Registration stages add the number of iterations and the final metric
+ * value for each resolution level, the level set stage the number of
+ * iterations and the final RMS change for each resolution.
+ *
+ * \ingroup SkullStrip
+ */
+struct StripTsStageMetrics
+{
+  std::string                Name;
+  double                     WallTime{ 0.0 };
+  double                     CPUTime{ 0.0 };
+  ThreadIdType               NumberOfWorkUnits{ 0 };
+  SizeValueType              SampledPeakMemory{ 0 };
+  SizeValueType              NumberOfVoxels{ 0 };
+  std::vector<SizeValueType> Iterations;
+  std::vector<double>        MetricValues;
+  std::vector<double>        RMSChanges;
+};
+
+
+/** \class StripTsStageEndEvent
+ * \brief invoked by StripTsImageFilter after each of its stages
+ *
+ * The metrics of the finished stage are the last entry of
+ * StripTsImageFilter::GetStageMetrics() when the event is handled.
+ *
+ * \ingroup SkullStrip
+ */
+// exported from this module, the event macros use ITKEvent_EXPORT
+#undef ITKEvent_EXPORT
+#define ITKEvent_EXPORT SkullStrip_EXPORT
+itkEventMacroDeclaration(StripTsStageEndEvent, AnyEvent);
+#undef ITKEvent_EXPORT
+#define ITKEvent_EXPORT ITKCommon_EXPORT
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,70 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkStripTsWorkingTypes_h
+#define itkStripTsWorkingTypes_h
+
+#include "itkImage.h"
+
+namespace itk
+{
+
+/** \struct StripTsWorkingTypes
+ * \brief image types StripTsImageFilter uses internally, by stage
+ *
+ * RegistrationImageType holds the downsampled patient image once it is
+ * rescaled to 0-255, AtlasRegistrationImageType the rescaled atlas image
+ * and its pyramid levels. Both are the fixed and moving image of the
+ * registrations and of the atlas resampling. LevelSetImageType is used
+ * for the feature image and the level set function.
+ *
+ * By default the registration runs in the pixel types of the patient and
+ * atlas images, which keeps results identical to earlier versions.
+ *
+ * \ingroup SkullStrip
+ */
+template <typename TImageType, typename TAtlasImageType>
+struct StripTsWorkingTypes
+{
+  using RegistrationImageType = TImageType;
+  using AtlasRegistrationImageType = TAtlasImageType;
+  using LevelSetImageType = Image<float, TImageType::ImageDimension>;
+};
+
+
+/** \struct StripTsCompactWorkingTypes
+ * \brief 8 bit registration images, float only for the level set
+ *
+ * The rescaled images take 0-255 only, so unsigned char loses no range.
+ * Intensities are rounded to integers after rescaling and after each
+ * smoothing of the registration pyramids, so results differ slightly
+ * from StripTsWorkingTypes unless the input images are unsigned char.
+ *
+ * \ingroup SkullStrip
+ */
+template <typename TImageType, typename TAtlasImageType>
+struct StripTsCompactWorkingTypes
+{
+  using RegistrationImageType = Image<unsigned char, TImageType::ImageDimension>;
+  using AtlasRegistrationImageType = Image<unsigned char, TAtlasImageType::ImageDimension>;
+  using LevelSetImageType = Image<float, TImageType::ImageDimension>;
+};
+
+} // end namespace itk
+
+#endif
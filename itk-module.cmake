@@ -12,7 +12,9 @@ file(READ "${MY_CURENT_DIR}/README.rst" DOCUMENTATION)
 itk_module(SkullStrip
   DEPENDS
     ITKLevelSets
+    ITKDistanceMap
     ITKRegistrationCommon
+    ITKRegistrationMethodsv4
     ITKIOImageBase
     ITKImageIntensity
     ITKIOMeta
@@ -34,7 +36,9 @@ itk_module(SkullStrip
     ITKIOTransformInsightLegacy
   TEST_DEPENDS
     ITKTestKernel
+    ITKImageStatistics
   EXCLUDE_FROM_DEFAULT
+  ENABLE_SHARED
   DESCRIPTION
     "${DOCUMENTATION}"
 )
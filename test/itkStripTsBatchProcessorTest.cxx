@@ -0,0 +1,173 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageDuplicator.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkStripTsBatchProcessor.h"
+#include "itkStripTsTestHelper.h"
+#include "itkTestingMacros.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+
+int
+itkStripTsBatchProcessorTest(int argc, char * argv[])
+{
+  if (argc < 7)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " patientImageFile atlasImageFile atlasMaskFile"
+              << " outputMask baselineMask minimumDice" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string patientImageFilename = argv[1];
+  std::string atlasImageFilename = argv[2];
+  std::string atlasMaskFilename = argv[3];
+  double      minimumDice = std::atof(argv[6]);
+
+  using ImageType = itk::Image<int, 3>;
+  using AtlasImageType = itk::Image<short, 3>;
+  using AtlasLabelType = itk::Image<unsigned char, 3>;
+
+
+  // Read input images
+  using ReaderType = itk::ImageFileReader<ImageType>;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(patientImageFilename);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(reader->Update());
+
+
+  using AtlasReaderType = itk::ImageFileReader<AtlasImageType>;
+  AtlasReaderType::Pointer atlasReader = AtlasReaderType::New();
+  atlasReader->SetFileName(atlasImageFilename);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(atlasReader->Update());
+
+
+  using LabelReaderType = itk::ImageFileReader<AtlasLabelType>;
+  LabelReaderType::Pointer labelReader = LabelReaderType::New();
+  labelReader->SetFileName(atlasMaskFilename);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(labelReader->Update());
+
+
+  // Second subject is a copy of the first one, the third one is missing
+  using DuplicatorType = itk::ImageDuplicator<ImageType>;
+  DuplicatorType::Pointer duplicator = DuplicatorType::New();
+  duplicator->SetInputImage(reader->GetOutput());
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(duplicator->Update());
+
+
+  // The fourth subject is smaller than one voxel of the registration grid,
+  // so the filter itself fails on it
+  ImageType::Pointer  tinyImage = ImageType::New();
+  ImageType::SizeType tinySize;
+  tinySize.Fill(1);
+  tinyImage->SetRegions(tinySize);
+  ImageType::SpacingType tinySpacing;
+  tinySpacing.Fill(0.5);
+  tinyImage->SetSpacing(tinySpacing);
+  tinyImage->Allocate();
+  tinyImage->FillBuffer(100);
+
+
+  // Set up batch processor
+  using BatchProcessorType = itk::StripTsBatchProcessor<ImageType, AtlasImageType, AtlasLabelType>;
+  BatchProcessorType::Pointer batchProcessor = BatchProcessorType::New();
+
+  ITK_EXERCISE_BASIC_OBJECT_METHODS(batchProcessor, StripTsBatchProcessor, Object);
+
+  batchProcessor->SetAtlasImage(atlasReader->GetOutput());
+  batchProcessor->SetAtlasBrainMask(labelReader->GetOutput());
+  batchProcessor->AddPatientImage(reader->GetOutput());
+  batchProcessor->AddPatientImage(duplicator->GetOutput());
+  batchProcessor->AddPatientImage(nullptr);
+  batchProcessor->AddPatientImage(tinyImage);
+  ITK_TEST_EXPECT_EQUAL(batchProcessor->GetNumberOfSubjects(), 4u);
+
+  // the budget is limited to the global thread pool, which runs the work units of all subjects
+  const itk::ThreadIdType poolThreads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+  const itk::ThreadIdType usableBudget = std::min<itk::ThreadIdType>(2, poolThreads);
+
+  batchProcessor->SetThreadBudget(poolThreads + 8);
+  ITK_TEST_EXPECT_EQUAL(batchProcessor->GetUsableThreadBudget(), poolThreads);
+
+  batchProcessor->SetThreadBudget(2);
+  ITK_TEST_SET_GET_VALUE(2u, batchProcessor->GetThreadBudget());
+  ITK_TEST_EXPECT_EQUAL(batchProcessor->GetUsableThreadBudget(), usableBudget);
+
+  // one subject never gets more work units than the usable budget
+  batchProcessor->SetThreadsPerSubject(4);
+  ITK_TEST_EXPECT_EQUAL(batchProcessor->GetWorkUnitsPerSubject(), usableBudget);
+  ITK_TEST_EXPECT_EQUAL(batchProcessor->GetNumberOfConcurrentSubjects(), 1u);
+
+  batchProcessor->SetThreadsPerSubject(1);
+  ITK_TEST_SET_GET_VALUE(1u, batchProcessor->GetThreadsPerSubject());
+  ITK_TEST_EXPECT_EQUAL(batchProcessor->GetNumberOfConcurrentSubjects(), usableBudget);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(batchProcessor->Update());
+
+
+  // The missing and the tiny subject fail without affecting the others
+  ITK_TEST_EXPECT_TRUE(batchProcessor->GetSubjectSucceeded(0));
+  ITK_TEST_EXPECT_TRUE(batchProcessor->GetSubjectSucceeded(1));
+  ITK_TEST_EXPECT_TRUE(!batchProcessor->GetSubjectSucceeded(2));
+  ITK_TEST_EXPECT_TRUE(!batchProcessor->GetSubjectErrorMessage(2).empty());
+  ITK_TEST_EXPECT_TRUE(!batchProcessor->GetSubjectSucceeded(3));
+  ITK_TEST_EXPECT_TRUE(batchProcessor->GetSubjectErrorMessage(3).find("smaller than 1mm") != std::string::npos);
+  std::cout << "Subject 3 failed: " << batchProcessor->GetSubjectErrorMessage(3) << std::endl;
+  ITK_TEST_EXPECT_EQUAL(batchProcessor->GetNumberOfSucceededSubjects(), 2u);
+  ITK_TEST_EXPECT_TRUE(batchProcessor->GetSubjectsPerHour() > 0.0);
+
+  for (itk::SizeValueType subject = 0; subject < batchProcessor->GetNumberOfSubjects(); ++subject)
+  {
+    std::cout << "Subject " << subject << ": " << batchProcessor->GetSubjectTime(subject) << " seconds" << std::endl;
+  }
+  std::cout << "Throughput: " << batchProcessor->GetSubjectsPerHour() << " subjects per hour" << std::endl;
+
+
+  // Subjects running side by side draw the metric sampling seeds in a racy order
+  // and use fewer work units than a single filter, so their masks are compared
+  // to the single filter baseline with a Dice tolerance
+  AtlasLabelType::Pointer baselineMask;
+  ITK_TRY_EXPECT_NO_EXCEPTION(baselineMask = StripTsTest::ReadImage<AtlasLabelType>(argv[5]));
+
+  if (!StripTsTest::MasksAgree(batchProcessor->GetOutput(0), baselineMask, "subject 0 / baseline", minimumDice) ||
+      !StripTsTest::MasksAgree(batchProcessor->GetOutput(1), baselineMask, "subject 1 / baseline", minimumDice))
+  {
+    return EXIT_FAILURE;
+  }
+
+
+  // Write mask of the first subject
+  using MaskWriterType = itk::ImageFileWriter<AtlasLabelType>;
+  MaskWriterType::Pointer maskWriter = MaskWriterType::New();
+  maskWriter->SetInput(batchProcessor->GetOutput(0));
+  maskWriter->SetFileName(argv[4]);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(maskWriter->Update());
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileWriter.h"
+#include "itkMinimumMaximumImageCalculator.h"
+#include "itkStripTsTestHelper.h"
+#include "itkTestingMacros.h"
+
+#include <cstdlib>
+#include <type_traits>
+
+
+int
+itkStripTsCompactWorkingTypesTest(int argc, char * argv[])
+{
+  if (argc < 6)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " patientImageFile atlasImageFile atlasMaskFile"
+              << " outputMask minimumDice" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  double minimumDice = std::atof(argv[5]);
+
+  using ImageType = StripTsTest::ImageType;
+  using AtlasImageType = StripTsTest::AtlasImageType;
+  using AtlasLabelType = StripTsTest::AtlasLabelType;
+
+
+  // Read input images
+  StripTsTest::Inputs inputs;
+  ITK_TRY_EXPECT_NO_EXCEPTION(inputs = StripTsTest::ReadInputs(argv[1], argv[2], argv[3]));
+
+
+  // Skull-strip with the working types of the input images and with compact working types
+  using StripTsFilterType = StripTsTest::FilterType;
+  using CompactWorkingTypes = itk::StripTsCompactWorkingTypes<ImageType, AtlasImageType>;
+  using CompactFilterType = itk::StripTsImageFilter<ImageType, AtlasImageType, AtlasLabelType, CompactWorkingTypes>;
+
+  static_assert(std::is_same<StripTsFilterType::RegistrationImageType, ImageType>::value,
+                "default registration image type has to be the patient image type");
+  static_assert(std::is_same<CompactFilterType::RegistrationImageType, itk::Image<unsigned char, 3>>::value,
+                "compact registration image type has to be unsigned char");
+  static_assert(std::is_same<CompactFilterType::LevelSetImageType, itk::Image<float, 3>>::value,
+                "compact level set image type has to be float");
+
+  StripTsFilterType::Pointer defaultFilter = StripTsFilterType::New();
+  defaultFilter->SetInput(inputs.PatientImage);
+  defaultFilter->SetAtlasImage(inputs.AtlasImage);
+  defaultFilter->SetAtlasBrainMask(inputs.AtlasBrainMask);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(defaultFilter->Update());
+
+
+  // the prepared atlas of the compact filter stores unsigned char images
+  CompactFilterType::PreparedAtlasType::Pointer preparedAtlas;
+  ITK_TRY_EXPECT_NO_EXCEPTION(preparedAtlas = StripTsTest::PrepareAtlas<CompactFilterType>(inputs));
+
+  using CompactImageType = CompactFilterType::PreparedAtlasType::WorkingImageType;
+  static_assert(std::is_same<CompactImageType, itk::Image<unsigned char, 3>>::value,
+                "compact prepared atlas image type has to be unsigned char");
+
+  // the atlas intensities are rescaled onto the full range of unsigned char, the mask is binary
+  using ImageCalculatorType = itk::MinimumMaximumImageCalculator<CompactImageType>;
+  ImageCalculatorType::Pointer imageCalculator = ImageCalculatorType::New();
+  imageCalculator->SetImage(preparedAtlas->GetAtlasImage());
+  imageCalculator->Compute();
+  ITK_TEST_EXPECT_EQUAL(static_cast<int>(imageCalculator->GetMinimum()), 0);
+  ITK_TEST_EXPECT_EQUAL(static_cast<int>(imageCalculator->GetMaximum()), 255);
+
+  using LabelCalculatorType = itk::MinimumMaximumImageCalculator<AtlasLabelType>;
+  LabelCalculatorType::Pointer labelCalculator = LabelCalculatorType::New();
+  labelCalculator->SetImage(preparedAtlas->GetAtlasLabels());
+  labelCalculator->Compute();
+  ITK_TEST_EXPECT_EQUAL(static_cast<int>(labelCalculator->GetMinimum()), 0);
+  ITK_TEST_EXPECT_EQUAL(static_cast<int>(labelCalculator->GetMaximum()), 1);
+
+  // every pyramid level keeps intensities after shrinking the unsigned char atlas
+  for (unsigned int level = 0; level < preparedAtlas->GetNumberOfLevels(); ++level)
+  {
+    imageCalculator->SetImage(preparedAtlas->GetPyramidLevel(level));
+    imageCalculator->Compute();
+    std::cout << "Pyramid level " << level << ": " << static_cast<int>(imageCalculator->GetMinimum()) << " - "
+              << static_cast<int>(imageCalculator->GetMaximum()) << std::endl;
+    ITK_TEST_EXPECT_TRUE(imageCalculator->GetMaximum() > 0);
+  }
+
+  CompactFilterType::Pointer compactFilter = StripTsTest::CreateFilter<CompactFilterType>(inputs, preparedAtlas);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(compactFilter->Update());
+
+
+  // Compare both masks
+  std::cout << "Default working types:" << std::endl << defaultFilter->GetTimerReport();
+  std::cout << "Compact working types:" << std::endl << compactFilter->GetTimerReport();
+
+  if (!StripTsTest::MasksAgree(compactFilter->GetOutput(),
+                               defaultFilter->GetOutput(),
+                               "default / compact working types",
+                               minimumDice))
+  {
+    return EXIT_FAILURE;
+  }
+
+
+  // Write mask obtained with compact working types
+  using MaskWriterType = itk::ImageFileWriter<AtlasLabelType>;
+  MaskWriterType::Pointer maskWriter = MaskWriterType::New();
+  maskWriter->SetInput(compactFilter->GetOutput());
+  maskWriter->SetFileName(argv[4]);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(maskWriter->Update());
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
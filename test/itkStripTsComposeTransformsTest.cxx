@@ -0,0 +1,108 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileWriter.h"
+#include "itkStripTsTestHelper.h"
+#include "itkTestingMacros.h"
+
+#include <cstdlib>
+#include <vector>
+
+
+int
+itkStripTsComposeTransformsTest(int argc, char * argv[])
+{
+  if (argc < 6)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " patientImageFile atlasImageFile atlasMaskFile"
+              << " outputMask minimumDice" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  double minimumDice = std::atof(argv[5]);
+
+
+  // Read input images
+  StripTsTest::Inputs inputs;
+  ITK_TRY_EXPECT_NO_EXCEPTION(inputs = StripTsTest::ReadInputs(argv[1], argv[2], argv[3]));
+
+
+  // Skull-strip with resampling after each registration stage and with composed transforms
+  using StripTsFilterType = StripTsTest::FilterType;
+
+  StripTsFilterType::PreparedAtlasType::Pointer preparedAtlas;
+  ITK_TRY_EXPECT_NO_EXCEPTION(preparedAtlas = StripTsTest::PrepareAtlas<StripTsFilterType>(inputs));
+
+
+  StripTsFilterType::Pointer stagedFilter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  ITK_TEST_SET_GET_BOOLEAN(stagedFilter, ComposeRegistrationTransforms, false);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(stagedFilter->Update());
+
+
+  // composed transforms are the default
+  StripTsFilterType::Pointer composedFilter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  ITK_TEST_EXPECT_TRUE(composedFilter->GetComposeRegistrationTransforms());
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(composedFilter->Update());
+
+
+  // Registration stages count the registered grid and every resampled atlas image. Staged transforms resample
+  // atlas image and mask after the rigid stage, composed transforms only resample the mask after the affine stage.
+  const std::vector<StripTsFilterType::StageMetricsType> & stagedMetrics = stagedFilter->GetStageMetrics();
+  const std::vector<StripTsFilterType::StageMetricsType> & composedMetrics = composedFilter->GetStageMetrics();
+  ITK_TEST_EXPECT_EQUAL(stagedMetrics.size(), 7u);
+  ITK_TEST_EXPECT_EQUAL(composedMetrics.size(), 7u);
+  ITK_TEST_EXPECT_EQUAL(stagedMetrics[2].Name, "RigidRegistration");
+  ITK_TEST_EXPECT_EQUAL(stagedMetrics[3].Name, "AffineRegistration");
+  ITK_TEST_EXPECT_EQUAL(composedMetrics[2].Name, "RigidRegistration");
+  ITK_TEST_EXPECT_EQUAL(composedMetrics[3].Name, "AffineRegistration");
+
+  const itk::SizeValueType gridVoxels = composedMetrics[2].NumberOfVoxels;
+  ITK_TEST_EXPECT_TRUE(gridVoxels > 0);
+  ITK_TEST_EXPECT_EQUAL(composedMetrics[3].NumberOfVoxels, 2 * gridVoxels);
+  ITK_TEST_EXPECT_EQUAL(stagedMetrics[2].NumberOfVoxels, 3 * gridVoxels);
+  ITK_TEST_EXPECT_EQUAL(stagedMetrics[3].NumberOfVoxels, 2 * gridVoxels);
+
+
+  // Compare both masks
+  std::cout << "Staged transforms:" << std::endl << stagedFilter->GetTimerReport();
+  std::cout << "Composed transforms:" << std::endl << composedFilter->GetTimerReport();
+
+  if (!StripTsTest::MasksAgree(composedFilter->GetOutput(),
+                               stagedFilter->GetOutput(),
+                               "staged / composed transforms",
+                               minimumDice))
+  {
+    return EXIT_FAILURE;
+  }
+
+
+  // Write mask obtained with composed transforms
+  using MaskWriterType = itk::ImageFileWriter<StripTsTest::AtlasLabelType>;
+  MaskWriterType::Pointer maskWriter = MaskWriterType::New();
+  maskWriter->SetInput(composedFilter->GetOutput());
+  maskWriter->SetFileName(argv[4]);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(maskWriter->Update());
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
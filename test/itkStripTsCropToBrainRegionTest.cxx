@@ -0,0 +1,135 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileWriter.h"
+#include "itkStripTsTestHelper.h"
+#include "itkTestingMacros.h"
+
+#include <cstdlib>
+
+
+int
+itkStripTsCropToBrainRegionTest(int argc, char * argv[])
+{
+  if (argc < 6)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " patientImageFile atlasImageFile atlasMaskFile"
+              << " outputMask minimumDice" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  double minimumDice = std::atof(argv[5]);
+
+
+  // Read input images
+  StripTsTest::Inputs inputs;
+  ITK_TRY_EXPECT_NO_EXCEPTION(inputs = StripTsTest::ReadInputs(argv[1], argv[2], argv[3]));
+
+
+  // Skull-strip the whole image and only the brain region
+  using StripTsFilterType = StripTsTest::FilterType;
+
+  StripTsFilterType::PreparedAtlasType::Pointer preparedAtlas;
+  ITK_TRY_EXPECT_NO_EXCEPTION(preparedAtlas = StripTsTest::PrepareAtlas<StripTsFilterType>(inputs));
+
+
+  StripTsFilterType::Pointer uncroppedFilter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  ITK_TEST_SET_GET_BOOLEAN(uncroppedFilter, CropToBrainRegion, false);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(uncroppedFilter->Update());
+
+
+  StripTsFilterType::Pointer croppedFilter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  croppedFilter->CropToBrainRegionOn();
+
+  // a negative margin is clamped to 0
+  croppedFilter->SetBrainRegionMargin(-5.0);
+  ITK_TEST_EXPECT_EQUAL(croppedFilter->GetBrainRegionMargin(), 0.0);
+
+  const double brainRegionMargin = 25.0;
+  croppedFilter->SetBrainRegionMargin(brainRegionMargin);
+  ITK_TEST_SET_GET_VALUE(brainRegionMargin, croppedFilter->GetBrainRegionMargin());
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(croppedFilter->Update());
+
+
+  // The cropped run still covers the whole input
+  const StripTsTest::ImageType *      input = inputs.PatientImage;
+  const StripTsTest::AtlasLabelType * croppedMask = croppedFilter->GetOutput();
+  ITK_TEST_EXPECT_EQUAL(croppedMask->GetLargestPossibleRegion(), input->GetLargestPossibleRegion());
+  ITK_TEST_EXPECT_EQUAL(croppedMask->GetBufferedRegion(), input->GetLargestPossibleRegion());
+  ITK_TEST_EXPECT_EQUAL(croppedMask->GetSpacing(), input->GetSpacing());
+  ITK_TEST_EXPECT_EQUAL(croppedMask->GetOrigin(), input->GetOrigin());
+  ITK_TEST_EXPECT_EQUAL(croppedMask->GetDirection(), input->GetDirection());
+
+
+  // The level set stage counts the voxels of its 2mm and 1mm grids; without cropping
+  // these cover the whole input, cropped they are smaller
+  itk::SizeValueType fullGridVoxels = 0;
+  for (const double isoSpacing : { 2.0, 1.0 })
+  {
+    itk::SizeValueType gridVoxels = 1;
+    for (unsigned int dim = 0; dim < 3; ++dim)
+    {
+      const double extent = input->GetLargestPossibleRegion().GetSize()[dim] * input->GetSpacing()[dim];
+      gridVoxels *= static_cast<itk::SizeValueType>(extent / isoSpacing);
+    }
+    fullGridVoxels += gridVoxels;
+  }
+
+  const auto levelSetVoxels = [](const StripTsFilterType * filter) {
+    itk::SizeValueType voxels = 0;
+    for (const StripTsFilterType::StageMetricsType & stage : filter->GetStageMetrics())
+    {
+      if (stage.Name == "LevelSet")
+      {
+        voxels = stage.NumberOfVoxels;
+      }
+    }
+    return voxels;
+  };
+  std::cout << "Level set voxels: full grids " << fullGridVoxels << ", uncropped " << levelSetVoxels(uncroppedFilter)
+            << ", cropped " << levelSetVoxels(croppedFilter) << std::endl;
+  ITK_TEST_EXPECT_EQUAL(levelSetVoxels(uncroppedFilter), fullGridVoxels);
+  ITK_TEST_EXPECT_TRUE(levelSetVoxels(croppedFilter) > 0);
+  ITK_TEST_EXPECT_TRUE(levelSetVoxels(croppedFilter) < fullGridVoxels);
+
+
+  // Compare both masks
+  std::cout << "Uncropped:" << std::endl << uncroppedFilter->GetTimerReport();
+  std::cout << "Cropped to the brain region:" << std::endl << croppedFilter->GetTimerReport();
+
+  if (!StripTsTest::MasksAgree(croppedMask, uncroppedFilter->GetOutput(), "uncropped / cropped", minimumDice))
+  {
+    return EXIT_FAILURE;
+  }
+
+
+  // Write mask obtained in the brain region
+  using MaskWriterType = itk::ImageFileWriter<StripTsTest::AtlasLabelType>;
+  MaskWriterType::Pointer maskWriter = MaskWriterType::New();
+  maskWriter->SetInput(croppedFilter->GetOutput());
+  maskWriter->SetFileName(argv[4]);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(maskWriter->Update());
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
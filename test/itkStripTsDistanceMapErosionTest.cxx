@@ -0,0 +1,108 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileWriter.h"
+#include "itkStripTsTestHelper.h"
+#include "itkTestingMacros.h"
+
+#include <cstdlib>
+#include <vector>
+
+
+int
+itkStripTsDistanceMapErosionTest(int argc, char * argv[])
+{
+  if (argc < 6)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " patientImageFile atlasImageFile atlasMaskFile"
+              << " outputMask minimumDice" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  double minimumDice = std::atof(argv[5]);
+
+
+  // Read input images
+  StripTsTest::Inputs inputs;
+  ITK_TRY_EXPECT_NO_EXCEPTION(inputs = StripTsTest::ReadInputs(argv[1], argv[2], argv[3]));
+
+
+  // Skull-strip with the structuring element erosion and with the distance map erosion
+  using StripTsFilterType = StripTsTest::FilterType;
+
+  StripTsFilterType::PreparedAtlasType::Pointer preparedAtlas;
+  ITK_TRY_EXPECT_NO_EXCEPTION(preparedAtlas = StripTsTest::PrepareAtlas<StripTsFilterType>(inputs));
+
+
+  StripTsFilterType::Pointer binaryFilter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  ITK_TEST_SET_GET_BOOLEAN(binaryFilter, UseDistanceMapErosion, false);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(binaryFilter->Update());
+
+
+  StripTsFilterType::Pointer distanceFilter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  distanceFilter->UseDistanceMapErosionOn();
+
+  // a negative radius would dilate the mask, it is clamped to 0
+  distanceFilter->SetErosionRadius(-1.0);
+  ITK_TEST_SET_GET_VALUE(0.0, distanceFilter->GetErosionRadius());
+
+  const double erosionRadius = 3.0;
+  distanceFilter->SetErosionRadius(erosionRadius);
+  ITK_TEST_SET_GET_VALUE(erosionRadius, distanceFilter->GetErosionRadius());
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(distanceFilter->Update());
+
+
+  // The erosion stage is named after the erosion that ran
+  const std::vector<StripTsFilterType::StageMetricsType> & binaryMetrics = binaryFilter->GetStageMetrics();
+  const std::vector<StripTsFilterType::StageMetricsType> & distanceMetrics = distanceFilter->GetStageMetrics();
+  ITK_TEST_EXPECT_EQUAL(binaryMetrics.size(), 7u);
+  ITK_TEST_EXPECT_EQUAL(distanceMetrics.size(), 7u);
+  ITK_TEST_EXPECT_EQUAL(binaryMetrics[4].Name, "BinaryErosion");
+  ITK_TEST_EXPECT_EQUAL(distanceMetrics[4].Name, "DistanceMapErosion");
+  ITK_TEST_EXPECT_TRUE(distanceFilter->GetTimerReport().find("5 DistanceMapErosion") != std::string::npos);
+  ITK_TEST_EXPECT_TRUE(distanceFilter->GetTimerReport().find("BinaryErosion") == std::string::npos);
+
+
+  // Compare both masks
+  std::cout << "Binary erosion:" << std::endl << binaryFilter->GetTimerReport();
+  std::cout << "Distance map erosion:" << std::endl << distanceFilter->GetTimerReport();
+
+  if (!StripTsTest::MasksAgree(distanceFilter->GetOutput(),
+                               binaryFilter->GetOutput(),
+                               "binary / distance map erosion",
+                               minimumDice))
+  {
+    return EXIT_FAILURE;
+  }
+
+
+  // Write mask obtained with the distance map erosion
+  using MaskWriterType = itk::ImageFileWriter<StripTsTest::AtlasLabelType>;
+  MaskWriterType::Pointer maskWriter = MaskWriterType::New();
+  maskWriter->SetInput(distanceFilter->GetOutput());
+  maskWriter->SetFileName(argv[4]);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(maskWriter->Update());
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
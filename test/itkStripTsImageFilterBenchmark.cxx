@@ -0,0 +1,272 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkMultiThreaderBase.h"
+#include "itkStripTsImageFilter.h"
+#include "itkStripTsTestHelper.h"
+#include "itkTestingMacros.h"
+#include "itkTimeProbe.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+
+using ImageType = itk::Image<int, 3>;
+using AtlasImageType = itk::Image<short, 3>;
+using AtlasLabelType = itk::Image<unsigned char, 3>;
+
+// intensities of brain, CSF, skull, scalp and background of a phantom
+struct PhantomContrast
+{
+  double Brain;
+  double CSF;
+  double Skull;
+  double Scalp;
+  double Background;
+};
+
+// normalized radius of a point in an ellipsoidal head filling most of the field of view
+template <typename TImage>
+double
+HeadRadius(const TImage * image, const typename TImage::IndexType & index, double scale, double shift)
+{
+  typename TImage::PointType point;
+  image->TransformIndexToPhysicalPoint(index, point);
+
+  double radius = 0.0;
+  for (unsigned int dim = 0; dim < 3; ++dim)
+  {
+    const double extent = image->GetLargestPossibleRegion().GetSize()[dim] * image->GetSpacing()[dim];
+    const double center = image->GetOrigin()[dim] + 0.5 * extent + shift;
+    const double semiAxis = scale * 0.45 * extent;
+    radius += (point[dim] - center) * (point[dim] - center) / (semiAxis * semiAxis);
+  }
+  return std::sqrt(radius);
+}
+
+// concentric ellipsoidal shells of brain, CSF, skull and scalp with Gaussian noise
+template <typename TImage>
+typename TImage::Pointer
+CreateHeadPhantom(const typename TImage::SizeType &    size,
+                  const typename TImage::SpacingType & spacing,
+                  double                               scale,
+                  double                               shift,
+                  const PhantomContrast &              contrast,
+                  unsigned int                         seed)
+{
+  typename TImage::Pointer image = TImage::New();
+  image->SetRegions(typename TImage::RegionType(size));
+  image->SetSpacing(spacing);
+  image->Allocate();
+
+  using GeneratorType = itk::Statistics::MersenneTwisterRandomVariateGenerator;
+  GeneratorType::Pointer generator = GeneratorType::New();
+  generator->SetSeed(seed);
+
+  const double noiseVariance = 0.03 * contrast.Scalp * 0.03 * contrast.Scalp;
+
+  itk::ImageRegionIteratorWithIndex<TImage> it(image, image->GetLargestPossibleRegion());
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  {
+    const double radius = HeadRadius(image.GetPointer(), it.GetIndex(), scale, shift);
+
+    double value = contrast.Background;
+    if (radius < 0.70)
+    {
+      value = contrast.Brain;
+    }
+    else if (radius < 0.76)
+    {
+      value = contrast.CSF;
+    }
+    else if (radius < 0.84)
+    {
+      value = contrast.Skull;
+    }
+    else if (radius < 0.92)
+    {
+      value = contrast.Scalp;
+    }
+    if (radius < 0.92)
+    {
+      value += generator->GetNormalVariate(0.0, noiseVariance);
+    }
+    it.Set(static_cast<typename TImage::PixelType>(std::max(value, 0.0)));
+  }
+  return image;
+}
+
+// brain of the phantom, used as ground truth for the patient and as atlas mask
+AtlasLabelType::Pointer
+CreateBrainMask(const AtlasLabelType::SizeType &    size,
+                const AtlasLabelType::SpacingType & spacing,
+                double                              scale,
+                double                              shift)
+{
+  AtlasLabelType::Pointer mask = AtlasLabelType::New();
+  mask->SetRegions(AtlasLabelType::RegionType(size));
+  mask->SetSpacing(spacing);
+  mask->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<AtlasLabelType> it(mask, mask->GetLargestPossibleRegion());
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  {
+    it.Set(HeadRadius(mask.GetPointer(), it.GetIndex(), scale, shift) < 0.70 ? 1 : 0);
+  }
+  return mask;
+}
+
+} // end namespace
+
+
+int
+itkStripTsImageFilterBenchmark(int argc, char * argv[])
+{
+  if (argc < 8)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " outputJSON sizeX sizeY sizeZ spacingX spacingY spacingZ"
+              << " [numberOfWorkUnits ...]" << std::endl;
+    std::cerr << "e.g. " << argv[0] << " benchmark512.json 512 512 512 0.5 0.5 0.5 1 4 16" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ImageType::SizeType    size;
+  ImageType::SpacingType spacing;
+  for (unsigned int dim = 0; dim < 3; ++dim)
+  {
+    size[dim] = std::atoi(argv[2 + dim]);
+    spacing[dim] = std::atof(argv[5 + dim]);
+  }
+
+  // default: single threaded and all threads
+  std::vector<unsigned int> workUnits;
+  for (int i = 8; i < argc; ++i)
+  {
+    workUnits.push_back(std::atoi(argv[i]));
+  }
+  if (workUnits.empty())
+  {
+    workUnits.push_back(1);
+    workUnits.push_back(itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads());
+  }
+
+
+  // Synthetic patient and a slightly larger, shifted atlas with a different contrast
+  // on a 1mm grid covering the same field of view
+  const PhantomContrast patientContrast = { 110.0, 30.0, 15.0, 140.0, 0.0 };
+  const PhantomContrast atlasContrast = { 600.0, 200.0, 100.0, 800.0, 0.0 };
+
+  ImageType::Pointer      patientImage = CreateHeadPhantom<ImageType>(size, spacing, 1.0, 0.0, patientContrast, 1);
+  AtlasLabelType::Pointer patientBrain = CreateBrainMask(size, spacing, 1.0, 0.0);
+
+  AtlasImageType::SizeType    atlasSize;
+  AtlasImageType::SpacingType atlasSpacing;
+  atlasSpacing.Fill(1.0);
+  for (unsigned int dim = 0; dim < 3; ++dim)
+  {
+    atlasSize[dim] = static_cast<itk::SizeValueType>(size[dim] * spacing[dim] / atlasSpacing[dim]);
+  }
+  AtlasImageType::Pointer atlasImage =
+    CreateHeadPhantom<AtlasImageType>(atlasSize, atlasSpacing, 1.05, 3.0, atlasContrast, 2);
+  AtlasLabelType::Pointer atlasMask = CreateBrainMask(atlasSize, atlasSpacing, 1.05, 3.0);
+
+
+  // The atlas is prepared once, as in a batch
+  using StripTsFilterType = itk::StripTsImageFilter<ImageType, AtlasImageType, AtlasLabelType>;
+  using PreparedAtlasType = StripTsFilterType::PreparedAtlasType;
+
+  PreparedAtlasType::Pointer preparedAtlas = PreparedAtlasType::New();
+  preparedAtlas->SetAtlasImage(atlasImage);
+  preparedAtlas->SetAtlasBrainMask(atlasMask);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(preparedAtlas->Prepare());
+
+
+  // Strip the phantom with each level set solver and number of work units
+  std::ostringstream json;
+  json << "{" << std::endl;
+  json << "  \"size\": [" << size[0] << ", " << size[1] << ", " << size[2] << "]," << std::endl;
+  json << "  \"spacing\": [" << spacing[0] << ", " << spacing[1] << ", " << spacing[2] << "]," << std::endl;
+  json << "  \"runs\": [";
+
+  for (size_t run = 0; run < 2 * workUnits.size(); ++run)
+  {
+    const bool         narrowBand = run >= workUnits.size();
+    const unsigned int runWorkUnits = workUnits[run % workUnits.size()];
+
+    StripTsFilterType::Pointer stripTsFilter = StripTsFilterType::New();
+    stripTsFilter->SetInput(patientImage);
+    stripTsFilter->SetPreparedAtlas(preparedAtlas);
+    stripTsFilter->SetUseNarrowBandLevelSet(narrowBand);
+    stripTsFilter->SetNumberOfWorkUnits(runWorkUnits);
+
+    itk::TimeProbe probe;
+    probe.Start();
+    ITK_TRY_EXPECT_NO_EXCEPTION(stripTsFilter->Update());
+    probe.Stop();
+
+    double levelSetTime = 0.0;
+    for (const StripTsFilterType::StageMetricsType & stage : stripTsFilter->GetStageMetrics())
+    {
+      if (stage.Name == "LevelSet")
+      {
+        levelSetTime = stage.WallTime;
+      }
+    }
+
+    const double dice = StripTsTest::DiceCoefficient(stripTsFilter->GetOutput(), patientBrain);
+    std::cout << (narrowBand ? "Narrow band, " : "Sparse field, ") << runWorkUnits
+              << " work units: " << probe.GetTotal() << " s, level set " << levelSetTime << " s, Dice " << dice
+              << std::endl;
+    std::cout << stripTsFilter->GetTimerReport();
+
+    // a mask unrelated to the phantom brain means the timings are meaningless
+    ITK_TEST_EXPECT_TRUE(dice > 0.5);
+
+    json << (run > 0 ? "," : "") << std::endl;
+    json << "    {\"narrowBand\": " << (narrowBand ? "true" : "false") << ", \"workUnits\": " << runWorkUnits
+         << ", \"totalTime\": " << probe.GetTotal() << ", \"levelSetTime\": " << levelSetTime
+         << ", \"dice\": " << dice << "," << std::endl;
+    json << "     \"metrics\": " << stripTsFilter->GetMetricsAsJSON() << "    }";
+  }
+  json << std::endl << "  ]" << std::endl << "}" << std::endl;
+
+
+  // Write results
+  std::ofstream jsonFile(argv[1]);
+  jsonFile << json.str();
+  if (!jsonFile)
+  {
+    std::cerr << "Test failed!" << std::endl;
+    std::cerr << "Could not write " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
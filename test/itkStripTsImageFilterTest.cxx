@@ -23,6 +23,7 @@
 #include "itkTestingMacros.h"
 
 #include <ctime>
+#include <string>
 
 
 int
@@ -84,6 +85,10 @@ itkStripTsImageFilterTest(int argc, char * argv[])
   stripTsFilter->SetAtlasImage(atlasReader->GetOutput());
   stripTsFilter->SetAtlasBrainMask(labelReader->GetOutput());
 
+  // transforms are composed by default, the baseline mask was generated with the staged registration
+  ITK_TEST_EXPECT_TRUE(stripTsFilter->GetComposeRegistrationTransforms());
+  stripTsFilter->ComposeRegistrationTransformsOff();
+
   ITK_TRY_EXPECT_NO_EXCEPTION(stripTsFilter->Update());
 
 
@@ -119,6 +124,36 @@ itkStripTsImageFilterTest(int argc, char * argv[])
   std::cout << stripTsFilter->GetTimerReport();
 
 
+  // A failing stage aborts the run with an exception naming the stage,
+  // here a patient image smaller than the 1mm registration grid
+  ImageType::Pointer  tinyImage = ImageType::New();
+  ImageType::SizeType tinySize;
+  tinySize.Fill(1);
+  ImageType::SpacingType tinySpacing;
+  tinySpacing.Fill(0.5);
+  tinyImage->SetRegions(ImageType::RegionType(tinySize));
+  tinyImage->SetSpacing(tinySpacing);
+  tinyImage->Allocate();
+  tinyImage->FillBuffer(100);
+
+  StripTsFilterType::Pointer failingFilter = StripTsFilterType::New();
+  failingFilter->SetInput(tinyImage);
+  failingFilter->SetAtlasImage(atlasReader->GetOutput());
+  failingFilter->SetAtlasBrainMask(labelReader->GetOutput());
+
+  std::string failureDescription;
+  try
+  {
+    failingFilter->Update();
+  }
+  catch (const itk::ExceptionObject & exception)
+  {
+    failureDescription = exception.GetDescription();
+  }
+  std::cout << "Expected failure: " << failureDescription << std::endl;
+  ITK_TEST_EXPECT_TRUE(failureDescription.find("DownsampleImage() failed") != std::string::npos);
+
+
   std::cout << "Test finished." << std::endl;
   return EXIT_SUCCESS;
 }
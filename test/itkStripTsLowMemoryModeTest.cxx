@@ -0,0 +1,131 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileWriter.h"
+#include "itkStripTsTestHelper.h"
+#include "itkTestingMacros.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+
+int
+itkStripTsLowMemoryModeTest(int argc, char * argv[])
+{
+  if (argc < 7)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " patientImageFile atlasImageFile atlasMaskFile"
+              << " outputMask outputLevelSetPeakMemory lowMemoryMode"
+              << " [referenceMask referenceLevelSetPeakMemory minimumDice]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Each configuration runs in its own process, so that memory freed by the
+  // other run does not hide or inflate the peak; the low memory run compares
+  // its mask and peak to those written by the run without it
+  const bool lowMemoryMode = std::atoi(argv[6]) != 0;
+  const bool compare = argc >= 10;
+
+
+  // Read input images
+  StripTsTest::Inputs inputs;
+  ITK_TRY_EXPECT_NO_EXCEPTION(inputs = StripTsTest::ReadInputs(argv[1], argv[2], argv[3]));
+
+
+  // Skull-strip cropped to the brain region
+  using StripTsFilterType = StripTsTest::FilterType;
+
+  StripTsFilterType::PreparedAtlasType::Pointer preparedAtlas;
+  ITK_TRY_EXPECT_NO_EXCEPTION(preparedAtlas = StripTsTest::PrepareAtlas<StripTsFilterType>(inputs));
+
+
+  StripTsFilterType::Pointer filter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  ITK_TEST_SET_GET_BOOLEAN(filter, LowMemoryMode, false);
+  filter->SetLowMemoryMode(lowMemoryMode);
+
+  // the memory mode does not crop on its own
+  ITK_TEST_EXPECT_TRUE(!filter->GetCropToBrainRegion());
+  filter->CropToBrainRegionOn();
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(filter->Update());
+
+
+  // Every stage reports its peak memory, cropping included
+  ITK_TEST_EXPECT_EQUAL(filter->GetStageMetrics().size(), 8u);
+
+  itk::SizeValueType brainRegionPeakMemory = 0;
+  itk::SizeValueType levelSetPeakMemory = 0;
+  for (const StripTsFilterType::StageMetricsType & stage : filter->GetStageMetrics())
+  {
+    if (stage.Name == "BrainRegion")
+    {
+      brainRegionPeakMemory = stage.SampledPeakMemory;
+    }
+    if (stage.Name == "LevelSet")
+    {
+      levelSetPeakMemory = stage.SampledPeakMemory;
+    }
+  }
+  ITK_TEST_EXPECT_TRUE(brainRegionPeakMemory > 0);
+  ITK_TEST_EXPECT_TRUE(levelSetPeakMemory > 0);
+
+  std::cout << (lowMemoryMode ? "Low memory mode:" : "Cropped:") << std::endl << filter->GetMemoryReport();
+  std::cout << filter->GetTimerReport();
+
+
+  // Write mask and level set peak memory
+  using MaskWriterType = itk::ImageFileWriter<StripTsTest::AtlasLabelType>;
+  MaskWriterType::Pointer maskWriter = MaskWriterType::New();
+  maskWriter->SetInput(filter->GetOutput());
+  maskWriter->SetFileName(argv[4]);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(maskWriter->Update());
+
+  std::ofstream peakMemoryFile(argv[5]);
+  peakMemoryFile << levelSetPeakMemory << std::endl;
+  ITK_TEST_EXPECT_TRUE(peakMemoryFile.good());
+
+
+  if (compare)
+  {
+    // Releasing intermediates early does not change the segmentation
+    StripTsTest::AtlasLabelType::Pointer referenceMask;
+    ITK_TRY_EXPECT_NO_EXCEPTION(referenceMask = StripTsTest::ReadImage<StripTsTest::AtlasLabelType>(argv[7]));
+
+    if (!StripTsTest::MasksAgree(filter->GetOutput(), referenceMask, "reference / this run", std::atof(argv[9])))
+    {
+      return EXIT_FAILURE;
+    }
+
+    // but lowers the sampled peak of the level set stage
+    itk::SizeValueType referencePeakMemory = 0;
+    std::ifstream      referencePeakMemoryFile(argv[8]);
+    referencePeakMemoryFile >> referencePeakMemory;
+    ITK_TEST_EXPECT_TRUE(!referencePeakMemoryFile.fail());
+
+    std::cout << "Level set sampled peak memory (kB): reference " << referencePeakMemory << ", this run "
+              << levelSetPeakMemory << std::endl;
+    ITK_TEST_EXPECT_TRUE(levelSetPeakMemory < referencePeakMemory);
+  }
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMath.h"
+#include "itkMultiThreaderBase.h"
+#include "itkStripTsNarrowBandGeodesicActiveContourLevelSetImageFilter.h"
+#include "itkTestingMacros.h"
+#include "itkTimeProbe.h"
+
+#include <cmath>
+
+namespace
+{
+
+using FloatImageType = itk::Image<float, 3>;
+
+// distance of the voxel to the center of the image
+double
+CenterDistance(const FloatImageType::IndexType & index, const FloatImageType::SizeType & size)
+{
+  double distance = 0.0;
+  for (unsigned int dim = 0; dim < 3; ++dim)
+  {
+    const double offset = index[dim] - 0.5 * (size[dim] - 1);
+    distance += offset * offset;
+  }
+  return std::sqrt(distance);
+}
+
+// number of voxels inside the zero level set
+itk::SizeValueType
+CountInside(const FloatImageType * levelSet)
+{
+  itk::SizeValueType                            inside = 0;
+  itk::ImageRegionConstIterator<FloatImageType> it(levelSet, levelSet->GetBufferedRegion());
+  for (; !it.IsAtEnd(); ++it)
+  {
+    inside += it.Get() < 0.0f;
+  }
+  return inside;
+}
+
+double
+SphereVolume(double radius)
+{
+  return 4.0 / 3.0 * itk::Math::pi * radius * radius * radius;
+}
+
+} // end namespace
+
+
+int
+itkStripTsNarrowBandGeodesicActiveContourLevelSetImageFilterTest(int, char *[])
+{
+  // Seed sphere of radius 6 in an edge sphere of radius 14: signed distance
+  // negative inside the seed, feature image 0 within 1.5 voxels of the edge
+  const double seedRadius = 6.0;
+  const double edgeRadius = 14.0;
+
+  FloatImageType::SizeType size;
+  size.Fill(48);
+  FloatImageType::RegionType region(size);
+
+  FloatImageType::Pointer initialLevelSet = FloatImageType::New();
+  initialLevelSet->SetRegions(region);
+  initialLevelSet->Allocate();
+
+  FloatImageType::Pointer featureImage = FloatImageType::New();
+  featureImage->SetRegions(region);
+  featureImage->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<FloatImageType> levelSetIt(initialLevelSet, region);
+  itk::ImageRegionIteratorWithIndex<FloatImageType> featureIt(featureImage, region);
+  for (; !levelSetIt.IsAtEnd(); ++levelSetIt, ++featureIt)
+  {
+    const double distance = CenterDistance(levelSetIt.GetIndex(), size);
+    levelSetIt.Set(static_cast<float>(distance - seedRadius));
+    featureIt.Set(std::abs(distance - edgeRadius) < 1.5 ? 0.0f : 1.0f);
+  }
+
+
+  using NarrowBandFilterType =
+    itk::StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter<FloatImageType, FloatImageType>;
+  NarrowBandFilterType::Pointer narrowBand = NarrowBandFilterType::New();
+
+  ITK_EXERCISE_BASIC_OBJECT_METHODS(
+    narrowBand, StripTsNarrowBandGeodesicActiveContourLevelSetImageFilter, NarrowBandLevelSetImageFilter);
+
+
+  // The derivative sigma is passed to the level set function, only a change modifies the filter
+  narrowBand->SetDerivativeSigma(1.0f);
+  ITK_TEST_SET_GET_VALUE(1.0f, narrowBand->GetDerivativeSigma());
+
+  const itk::ModifiedTimeType modifiedTime = narrowBand->GetMTime();
+  narrowBand->SetDerivativeSigma(1.0f);
+  ITK_TEST_EXPECT_EQUAL(narrowBand->GetMTime(), modifiedTime);
+  narrowBand->SetDerivativeSigma(2.0f);
+  ITK_TEST_SET_GET_VALUE(2.0f, narrowBand->GetDerivativeSigma());
+  ITK_TEST_EXPECT_TRUE(narrowBand->GetMTime() > modifiedTime);
+  narrowBand->SetDerivativeSigma(1.0f);
+
+
+  // Without propagation the seed does not grow; the speed image still has to be computed
+  narrowBand->SetInput(initialLevelSet);
+  narrowBand->SetFeatureImage(featureImage);
+  narrowBand->SetIsoSurfaceValue(0.0);
+  narrowBand->SetUseImageSpacing(true);
+  narrowBand->SetMaximumRMSError(0.001);
+  narrowBand->SetNumberOfIterations(500);
+  narrowBand->SetPropagationScaling(0.0);
+  narrowBand->SetCurvatureScaling(0.5);
+  narrowBand->SetAdvectionScaling(1.0);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(narrowBand->Update());
+
+  const itk::SizeValueType staticVolume = CountInside(narrowBand->GetOutput());
+  std::cout << "Without propagation: " << staticVolume << " voxels inside" << std::endl;
+  ITK_TEST_EXPECT_TRUE(staticVolume < SphereVolume(seedRadius + 2.0));
+
+
+  // With propagation the seed grows up to the edge and stops there,
+  // sequentially and split between all work units
+  narrowBand->SetPropagationScaling(1.0);
+
+  const itk::ThreadIdType workUnits[] = { 1, itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads() };
+  for (const itk::ThreadIdType numberOfWorkUnits : workUnits)
+  {
+    narrowBand->SetNumberOfWorkUnits(numberOfWorkUnits);
+
+    itk::TimeProbe probe;
+    probe.Start();
+    ITK_TRY_EXPECT_NO_EXCEPTION(narrowBand->Update());
+    probe.Stop();
+
+    const itk::SizeValueType volume = CountInside(narrowBand->GetOutput());
+    std::cout << numberOfWorkUnits << " work units: " << probe.GetTotal() << " s, "
+              << narrowBand->GetElapsedIterations() << " iterations, " << volume << " voxels inside" << std::endl;
+
+    ITK_TEST_EXPECT_TRUE(narrowBand->GetElapsedIterations() > 0);
+    ITK_TEST_EXPECT_TRUE(volume > SphereVolume(edgeRadius - 2.0));
+    ITK_TEST_EXPECT_TRUE(volume < SphereVolume(edgeRadius + 2.0));
+  }
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileWriter.h"
+#include "itkStripTsTestHelper.h"
+#include "itkTestingMacros.h"
+
+#include <cstdlib>
+
+
+int
+itkStripTsNarrowBandLevelSetTest(int argc, char * argv[])
+{
+  if (argc < 6)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " patientImageFile atlasImageFile atlasMaskFile"
+              << " outputMask minimumDice" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  double minimumDice = std::atof(argv[5]);
+
+
+  // Read input images
+  StripTsTest::Inputs inputs;
+  ITK_TRY_EXPECT_NO_EXCEPTION(inputs = StripTsTest::ReadInputs(argv[1], argv[2], argv[3]));
+
+
+  // Skull-strip with the sparse field and with the narrow band solver
+  using StripTsFilterType = StripTsTest::FilterType;
+
+  StripTsFilterType::PreparedAtlasType::Pointer preparedAtlas;
+  ITK_TRY_EXPECT_NO_EXCEPTION(preparedAtlas = StripTsTest::PrepareAtlas<StripTsFilterType>(inputs));
+
+
+  StripTsFilterType::Pointer sparseFieldFilter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  ITK_TEST_SET_GET_BOOLEAN(sparseFieldFilter, UseNarrowBandLevelSet, false);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(sparseFieldFilter->Update());
+
+
+  StripTsFilterType::Pointer narrowBandFilter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  narrowBandFilter->UseNarrowBandLevelSetOn();
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(narrowBandFilter->Update());
+
+
+  // The narrow band solver ran at 2mm and at 1mm within the iteration limits of the resolutions
+  for (const StripTsFilterType::StageMetricsType & stage : narrowBandFilter->GetStageMetrics())
+  {
+    if (stage.Name == "LevelSet")
+    {
+      ITK_TEST_EXPECT_EQUAL(stage.Iterations.size(), 2u);
+      ITK_TEST_EXPECT_EQUAL(stage.RMSChanges.size(), 2u);
+      ITK_TEST_EXPECT_TRUE(stage.Iterations[0] > 0 && stage.Iterations[0] <= 100);
+      ITK_TEST_EXPECT_TRUE(stage.Iterations[1] > 0 && stage.Iterations[1] <= 120);
+    }
+  }
+
+
+  // Compare both masks
+  std::cout << "Sparse field:" << std::endl << sparseFieldFilter->GetTimerReport();
+  std::cout << "Narrow band:" << std::endl << narrowBandFilter->GetTimerReport();
+
+  if (!StripTsTest::MasksAgree(narrowBandFilter->GetOutput(),
+                               sparseFieldFilter->GetOutput(),
+                               "sparse field / narrow band",
+                               minimumDice))
+  {
+    return EXIT_FAILURE;
+  }
+
+
+  // Write narrow band mask
+  using MaskWriterType = itk::ImageFileWriter<StripTsTest::AtlasLabelType>;
+  MaskWriterType::Pointer maskWriter = MaskWriterType::New();
+  maskWriter->SetInput(narrowBandFilter->GetOutput());
+  maskWriter->SetFileName(argv[4]);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(maskWriter->Update());
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkStripTsImageFilter.h"
+#include "itkStripTsPreparedAtlas.h"
+#include "itkTestingMacros.h"
+
+#include <fstream>
+
+
+int
+itkStripTsPreparedAtlasTest(int argc, char * argv[])
+{
+  if (argc < 6)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " patientImageFile atlasImageFile atlasMaskFile"
+              << " preparedAtlasPrefix outputMask" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string patientImageFilename = argv[1];
+  std::string atlasImageFilename = argv[2];
+  std::string atlasMaskFilename = argv[3];
+  std::string preparedAtlasPrefix = argv[4];
+
+  using ImageType = itk::Image<int, 3>;
+  using AtlasImageType = itk::Image<short, 3>;
+  using AtlasLabelType = itk::Image<unsigned char, 3>;
+
+
+  // Read input images
+  using ReaderType = itk::ImageFileReader<ImageType>;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(patientImageFilename);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(reader->Update());
+
+
+  using AtlasReaderType = itk::ImageFileReader<AtlasImageType>;
+  AtlasReaderType::Pointer atlasReader = AtlasReaderType::New();
+  atlasReader->SetFileName(atlasImageFilename);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(atlasReader->Update());
+
+
+  using LabelReaderType = itk::ImageFileReader<AtlasLabelType>;
+  LabelReaderType::Pointer labelReader = LabelReaderType::New();
+  labelReader->SetFileName(atlasMaskFilename);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(labelReader->Update());
+
+
+  // Prepare the atlas and store it
+  using PreparedAtlasType = itk::StripTsPreparedAtlas<AtlasImageType, AtlasLabelType>;
+  PreparedAtlasType::Pointer preparedAtlas = PreparedAtlasType::New();
+
+  ITK_EXERCISE_BASIC_OBJECT_METHODS(preparedAtlas, StripTsPreparedAtlas, Object);
+
+  ITK_TEST_EXPECT_TRUE(!preparedAtlas->IsPrepared());
+  ITK_TRY_EXPECT_EXCEPTION(preparedAtlas->Prepare());
+
+  preparedAtlas->SetAtlasImage(atlasReader->GetOutput());
+  preparedAtlas->SetAtlasBrainMask(labelReader->GetOutput());
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(preparedAtlas->Prepare());
+  ITK_TEST_EXPECT_TRUE(preparedAtlas->IsPrepared());
+  ITK_TEST_EXPECT_EQUAL(preparedAtlas->GetNumberOfLevels(), 2u);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(preparedAtlas->Write(preparedAtlasPrefix));
+
+
+  // Load the stored atlas again, as a batch job would
+  PreparedAtlasType::Pointer loadedAtlas = PreparedAtlasType::New();
+
+  ITK_TRY_EXPECT_EXCEPTION(loadedAtlas->Read(preparedAtlasPrefix + "Missing"));
+  ITK_TEST_EXPECT_TRUE(!loadedAtlas->IsPrepared());
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(loadedAtlas->Read(preparedAtlasPrefix));
+  ITK_TEST_EXPECT_TRUE(loadedAtlas->IsPrepared());
+  ITK_TEST_EXPECT_EQUAL(loadedAtlas->GetNumberOfLevels(), preparedAtlas->GetNumberOfLevels());
+  ITK_TEST_EXPECT_TRUE(loadedAtlas->GetSchedule() == preparedAtlas->GetSchedule());
+
+
+  // Perform skull-stripping with the loaded atlas
+  using StripTsFilterType = itk::StripTsImageFilter<ImageType, AtlasImageType, AtlasLabelType>;
+
+  // an atlas that was neither prepared nor read is rejected
+  StripTsFilterType::Pointer unpreparedFilter = StripTsFilterType::New();
+  unpreparedFilter->SetInput(reader->GetOutput());
+  unpreparedFilter->SetPreparedAtlas(PreparedAtlasType::New());
+
+  ITK_TRY_EXPECT_EXCEPTION(unpreparedFilter->Update());
+
+
+  StripTsFilterType::Pointer stripTsFilter = StripTsFilterType::New();
+
+  stripTsFilter->SetInput(reader->GetOutput());
+  stripTsFilter->SetPreparedAtlas(loadedAtlas);
+  ITK_TEST_SET_GET_VALUE(loadedAtlas.GetPointer(), stripTsFilter->GetPreparedAtlas());
+
+  // the baseline mask was generated with the staged registration
+  stripTsFilter->ComposeRegistrationTransformsOff();
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(stripTsFilter->Update());
+
+
+  // Write mask, it has to match the one obtained from the raw atlas
+  using MaskWriterType = itk::ImageFileWriter<AtlasLabelType>;
+  MaskWriterType::Pointer maskWriter = MaskWriterType::New();
+  maskWriter->SetInput(stripTsFilter->GetOutput());
+  maskWriter->SetFileName(argv[5]);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(maskWriter->Update());
+
+
+  std::cout << stripTsFilter->GetTimerReport();
+
+
+  // Levels that do not match the stored schedule are rejected, the atlas stays unchanged
+  {
+    std::ofstream scheduleFile(preparedAtlasPrefix + "Schedule.txt");
+    scheduleFile << "8 8 8" << std::endl << "2 2 2" << std::endl;
+  }
+  ITK_TRY_EXPECT_EXCEPTION(loadedAtlas->Read(preparedAtlasPrefix));
+  ITK_TEST_EXPECT_TRUE(loadedAtlas->IsPrepared());
+  ITK_TEST_EXPECT_TRUE(loadedAtlas->GetSchedule() == preparedAtlas->GetSchedule());
+
+  {
+    std::ofstream scheduleFile(preparedAtlasPrefix + "Schedule.txt");
+    scheduleFile << "4 4 4" << std::endl << "2 2 2" << std::endl << "1 1 1" << std::endl;
+  }
+  ITK_TRY_EXPECT_EXCEPTION(loadedAtlas->Read(preparedAtlasPrefix));
+  ITK_TEST_EXPECT_EQUAL(loadedAtlas->GetNumberOfLevels(), 2u);
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
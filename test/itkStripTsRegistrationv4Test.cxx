@@ -0,0 +1,131 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileWriter.h"
+#include "itkStripTsTestHelper.h"
+#include "itkTestingMacros.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+
+int
+itkStripTsRegistrationv4Test(int argc, char * argv[])
+{
+  if (argc < 6)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " patientImageFile atlasImageFile atlasMaskFile"
+              << " outputMask minimumDice" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  double minimumDice = std::atof(argv[5]);
+
+
+  // Read input images
+  StripTsTest::Inputs inputs;
+  ITK_TRY_EXPECT_NO_EXCEPTION(inputs = StripTsTest::ReadInputs(argv[1], argv[2], argv[3]));
+
+
+  // Skull-strip with the legacy and with the ITKv4 registration
+  using StripTsFilterType = StripTsTest::FilterType;
+
+  StripTsFilterType::PreparedAtlasType::Pointer preparedAtlas;
+  ITK_TRY_EXPECT_NO_EXCEPTION(preparedAtlas = StripTsTest::PrepareAtlas<StripTsFilterType>(inputs));
+
+
+  StripTsFilterType::Pointer legacyFilter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  ITK_TEST_SET_GET_BOOLEAN(legacyFilter, UseRegistrationv4, false);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(legacyFilter->Update());
+
+
+  StripTsFilterType::Pointer v4Filter = StripTsTest::CreateFilter<StripTsFilterType>(inputs, preparedAtlas);
+  v4Filter->UseRegistrationv4On();
+
+  const auto samplingStrategy = itk::ImageRegistrationMethodv4Enums::MetricSamplingStrategy::REGULAR;
+  v4Filter->SetMetricSamplingStrategy(samplingStrategy);
+  ITK_TEST_SET_GET_VALUE(samplingStrategy, v4Filter->GetMetricSamplingStrategy());
+
+  const double samplingPercentage = 0.25;
+  v4Filter->SetMetricSamplingPercentage(samplingPercentage);
+  ITK_TEST_SET_GET_VALUE(samplingPercentage, v4Filter->GetMetricSamplingPercentage());
+
+  ITK_TEST_SET_GET_BOOLEAN(v4Filter, UseHeadMask, true);
+
+  const double headMaskThreshold = 10.0;
+  v4Filter->SetHeadMaskThreshold(headMaskThreshold);
+  ITK_TEST_SET_GET_VALUE(headMaskThreshold, v4Filter->GetHeadMaskThreshold());
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(v4Filter->Update());
+
+
+  // The ITKv4 registration reports every level of the atlas pyramid, within the iteration limit of each stage
+  const std::vector<StripTsFilterType::StageMetricsType> & metrics = v4Filter->GetStageMetrics();
+  ITK_TEST_EXPECT_EQUAL(metrics.size(), 7u);
+
+  const unsigned int                    numberOfLevels = preparedAtlas->GetSchedule().rows();
+  const std::vector<std::string>        registrationStages = { "RigidRegistration", "AffineRegistration" };
+  const std::vector<itk::SizeValueType> maximumIterations = { 250, 200 };
+  for (size_t i = 0; i < registrationStages.size(); ++i)
+  {
+    const StripTsFilterType::StageMetricsType & stage = metrics[i + 2];
+    ITK_TEST_EXPECT_EQUAL(stage.Name, registrationStages[i]);
+    ITK_TEST_EXPECT_EQUAL(stage.Iterations.size(), numberOfLevels);
+    ITK_TEST_EXPECT_EQUAL(stage.MetricValues.size(), numberOfLevels);
+
+    for (unsigned int level = 0; level < numberOfLevels; ++level)
+    {
+      std::cout << stage.Name << " level " << level << ": " << stage.Iterations[level] << " iterations, metric "
+                << stage.MetricValues[level] << std::endl;
+      ITK_TEST_EXPECT_TRUE(stage.Iterations[level] > 0);
+      ITK_TEST_EXPECT_TRUE(stage.Iterations[level] <= maximumIterations[i]);
+      // Mattes mutual information is negative for images sharing any information
+      ITK_TEST_EXPECT_TRUE(std::isfinite(stage.MetricValues[level]));
+      ITK_TEST_EXPECT_TRUE(stage.MetricValues[level] < 0.0);
+    }
+  }
+
+
+  // Compare both masks
+  std::cout << "Legacy registration:" << std::endl << legacyFilter->GetTimerReport();
+  std::cout << "ITKv4 registration:" << std::endl << v4Filter->GetTimerReport();
+
+  if (!StripTsTest::MasksAgree(v4Filter->GetOutput(),
+                               legacyFilter->GetOutput(),
+                               "legacy / ITKv4 registration",
+                               minimumDice))
+  {
+    return EXIT_FAILURE;
+  }
+
+
+  // Write mask obtained with the ITKv4 registration
+  using MaskWriterType = itk::ImageFileWriter<StripTsTest::AtlasLabelType>;
+  MaskWriterType::Pointer maskWriter = MaskWriterType::New();
+  maskWriter->SetInput(v4Filter->GetOutput());
+  maskWriter->SetFileName(argv[4]);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(maskWriter->Update());
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
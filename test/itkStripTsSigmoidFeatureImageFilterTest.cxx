@@ -0,0 +1,115 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkStripTsSigmoidFeatureImageFilter.h"
+#include "itkRescaleIntensityImageFilter.h"
+#include "itkSigmoidImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkTestingMacros.h"
+
+
+int
+itkStripTsSigmoidFeatureImageFilterTest(int, char *[])
+{
+  using FloatImageType = itk::Image<float, 3>;
+
+
+  // Create a ramp with a bright blob as a stand-in for a gradient magnitude image
+  FloatImageType::SizeType size;
+  size.Fill(32);
+  FloatImageType::RegionType region(size);
+
+  FloatImageType::Pointer image = FloatImageType::New();
+  image->SetRegions(region);
+  image->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<FloatImageType> it(image, region);
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  {
+    const FloatImageType::IndexType index = it.GetIndex();
+    float                           value = 0.37f * index[0] + 0.11f * index[1] * index[2];
+    if (index[0] > 10 && index[0] < 20 && index[1] > 10 && index[1] < 20)
+    {
+      value += 40.0f;
+    }
+    it.Set(value);
+  }
+
+
+  // Reference: rescaler followed by sigmoid, as the level set stage used to do
+  using RescalerType = itk::RescaleIntensityImageFilter<FloatImageType, FloatImageType>;
+  RescalerType::Pointer rescaler = RescalerType::New();
+  rescaler->SetInput(image);
+  rescaler->SetOutputMinimum(0);
+  rescaler->SetOutputMaximum(255);
+
+  using SigmoidFilterType = itk::SigmoidImageFilter<FloatImageType, FloatImageType>;
+  SigmoidFilterType::Pointer sigmoid = SigmoidFilterType::New();
+  sigmoid->SetInput(rescaler->GetOutput());
+  sigmoid->SetOutputMinimum(0.0);
+  sigmoid->SetOutputMaximum(1.0);
+  sigmoid->SetAlpha(-2.0);
+  sigmoid->SetBeta(12.0);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(sigmoid->Update());
+
+
+  // Fused filter, not in place so the input stays available
+  using SigmoidFeatureFilterType = itk::StripTsSigmoidFeatureImageFilter<FloatImageType>;
+  SigmoidFeatureFilterType::Pointer sigmoidFeature = SigmoidFeatureFilterType::New();
+
+  ITK_EXERCISE_BASIC_OBJECT_METHODS(sigmoidFeature, StripTsSigmoidFeatureImageFilter, InPlaceImageFilter);
+
+  ITK_TEST_EXPECT_TRUE(sigmoidFeature->GetInPlace());
+  sigmoidFeature->InPlaceOff();
+
+  sigmoidFeature->SetInput(image);
+  sigmoidFeature->SetRescaleMinimum(0);
+  ITK_TEST_SET_GET_VALUE(0.0f, sigmoidFeature->GetRescaleMinimum());
+  sigmoidFeature->SetRescaleMaximum(255);
+  ITK_TEST_SET_GET_VALUE(255.0f, sigmoidFeature->GetRescaleMaximum());
+  sigmoidFeature->SetOutputMinimum(0.0);
+  ITK_TEST_SET_GET_VALUE(0.0f, sigmoidFeature->GetOutputMinimum());
+  sigmoidFeature->SetOutputMaximum(1.0);
+  ITK_TEST_SET_GET_VALUE(1.0f, sigmoidFeature->GetOutputMaximum());
+  sigmoidFeature->SetAlpha(-2.0);
+  ITK_TEST_SET_GET_VALUE(-2.0, sigmoidFeature->GetAlpha());
+  sigmoidFeature->SetBeta(12.0);
+  ITK_TEST_SET_GET_VALUE(12.0, sigmoidFeature->GetBeta());
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(sigmoidFeature->Update());
+
+
+  // Both have to agree exactly
+  itk::ImageRegionConstIterator<FloatImageType> refIt(sigmoid->GetOutput(), region);
+  itk::ImageRegionConstIterator<FloatImageType> outIt(sigmoidFeature->GetOutput(), region);
+  unsigned int                                  mismatches = 0;
+  for (; !refIt.IsAtEnd(); ++refIt, ++outIt)
+  {
+    if (itk::Math::NotExactlyEquals(refIt.Get(), outIt.Get()))
+    {
+      ++mismatches;
+    }
+  }
+  ITK_TEST_EXPECT_EQUAL(mismatches, 0u);
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkStripTsImageFilter.h"
+#include "itkTestingMacros.h"
+
+#include <fstream>
+#include <vector>
+
+
+int
+itkStripTsStageMetricsTest(int argc, char * argv[])
+{
+  if (argc < 6)
+  {
+    std::cerr << "Missing parameters." << std::endl;
+    std::cerr << "Usage: " << argv[0] << " patientImageFile atlasImageFile atlasMaskFile"
+              << " outputMask outputJSON" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string patientImageFilename = argv[1];
+  std::string atlasImageFilename = argv[2];
+  std::string atlasMaskFilename = argv[3];
+
+  using ImageType = itk::Image<int, 3>;
+  using AtlasImageType = itk::Image<short, 3>;
+  using AtlasLabelType = itk::Image<unsigned char, 3>;
+
+
+  // Read input images
+  using ReaderType = itk::ImageFileReader<ImageType>;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(patientImageFilename);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(reader->Update());
+
+
+  using AtlasReaderType = itk::ImageFileReader<AtlasImageType>;
+  AtlasReaderType::Pointer atlasReader = AtlasReaderType::New();
+  atlasReader->SetFileName(atlasImageFilename);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(atlasReader->Update());
+
+
+  using LabelReaderType = itk::ImageFileReader<AtlasLabelType>;
+  LabelReaderType::Pointer labelReader = LabelReaderType::New();
+  labelReader->SetFileName(atlasMaskFilename);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(labelReader->Update());
+
+
+  // Skull-strip and record every finished stage
+  using StripTsFilterType = itk::StripTsImageFilter<ImageType, AtlasImageType, AtlasLabelType>;
+  StripTsFilterType::Pointer stripTsFilter = StripTsFilterType::New();
+
+  stripTsFilter->SetInput(reader->GetOutput());
+  stripTsFilter->SetAtlasImage(atlasReader->GetOutput());
+  stripTsFilter->SetAtlasBrainMask(labelReader->GetOutput());
+
+  // the baseline mask was generated with the staged registration
+  stripTsFilter->ComposeRegistrationTransformsOff();
+
+  std::vector<std::string> finishedStages;
+  stripTsFilter->AddObserver(itk::StripTsStageEndEvent(), [&stripTsFilter, &finishedStages](const itk::EventObject &) {
+    finishedStages.push_back(stripTsFilter->GetStageMetrics().back().Name);
+  });
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(stripTsFilter->Update());
+
+
+  // One entry per stage, in execution order
+  const std::vector<StripTsFilterType::StageMetricsType> & metrics = stripTsFilter->GetStageMetrics();
+  ITK_TEST_EXPECT_EQUAL(metrics.size(), 7u);
+  ITK_TEST_EXPECT_EQUAL(finishedStages.size(), metrics.size());
+
+  const std::vector<std::string> stageNames = { "DownsampleImage", "RescaleImages", "RigidRegistration",
+                                                "AffineRegistration", "BinaryErosion", "LevelSet",
+                                                "UpsampleLabels" };
+  for (size_t i = 0; i < metrics.size(); ++i)
+  {
+    ITK_TEST_EXPECT_EQUAL(metrics[i].Name, stageNames[i]);
+    ITK_TEST_EXPECT_EQUAL(finishedStages[i], metrics[i].Name);
+    ITK_TEST_EXPECT_TRUE(metrics[i].WallTime >= 0.0);
+    ITK_TEST_EXPECT_TRUE(metrics[i].NumberOfVoxels > 0);
+    ITK_TEST_EXPECT_EQUAL(metrics[i].NumberOfWorkUnits, stripTsFilter->GetNumberOfWorkUnits());
+  }
+
+  // Registrations report each of their two levels, the level set each resolution
+  for (size_t i = 2; i < 4; ++i)
+  {
+    ITK_TEST_EXPECT_EQUAL(metrics[i].Iterations.size(), 2u);
+    ITK_TEST_EXPECT_EQUAL(metrics[i].MetricValues.size(), 2u);
+  }
+  ITK_TEST_EXPECT_EQUAL(metrics[5].Iterations.size(), 2u);
+  ITK_TEST_EXPECT_EQUAL(metrics[5].RMSChanges.size(), 2u);
+
+
+  // JSON export
+  const std::string json = stripTsFilter->GetMetricsAsJSON();
+  ITK_TEST_EXPECT_TRUE(json.find("\"name\": \"RigidRegistration\"") != std::string::npos);
+  ITK_TEST_EXPECT_TRUE(json.find("\"rmsChanges\"") != std::string::npos);
+
+  std::ofstream jsonFile(argv[5]);
+  jsonFile << json;
+  std::cout << json;
+
+
+  // Write mask, collecting metrics must not change it
+  using MaskWriterType = itk::ImageFileWriter<AtlasLabelType>;
+  MaskWriterType::Pointer maskWriter = MaskWriterType::New();
+  maskWriter->SetInput(stripTsFilter->GetOutput());
+  maskWriter->SetFileName(argv[4]);
+
+  ITK_TRY_EXPECT_NO_EXCEPTION(maskWriter->Update());
+
+
+  std::cout << "Test finished." << std::endl;
+  return EXIT_SUCCESS;
+}
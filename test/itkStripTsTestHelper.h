@@ -0,0 +1,123 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkStripTsTestHelper_h
+#define itkStripTsTestHelper_h
+
+#include "itkImageFileReader.h"
+#include "itkLabelOverlapMeasuresImageFilter.h"
+#include "itkStripTsImageFilter.h"
+
+#include <iostream>
+#include <string>
+
+// helpers for the tests comparing the masks of two configurations of StripTsImageFilter
+namespace StripTsTest
+{
+
+using ImageType = itk::Image<int, 3>;
+using AtlasImageType = itk::Image<short, 3>;
+using AtlasLabelType = itk::Image<unsigned char, 3>;
+using FilterType = itk::StripTsImageFilter<ImageType, AtlasImageType, AtlasLabelType>;
+
+// patient image, atlas image and atlas brain mask read from the test data
+struct Inputs
+{
+  ImageType::Pointer      PatientImage;
+  AtlasImageType::Pointer AtlasImage;
+  AtlasLabelType::Pointer AtlasBrainMask;
+};
+
+template <typename TImage>
+typename TImage::Pointer
+ReadImage(const std::string & filename)
+{
+  using ReaderType = itk::ImageFileReader<TImage>;
+  typename ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(filename);
+  reader->Update();
+  return reader->GetOutput();
+}
+
+// throws an ExceptionObject if one of the files cannot be read
+inline Inputs
+ReadInputs(const std::string & patientImageFilename,
+           const std::string & atlasImageFilename,
+           const std::string & atlasMaskFilename)
+{
+  Inputs inputs;
+  inputs.PatientImage = ReadImage<ImageType>(patientImageFilename);
+  inputs.AtlasImage = ReadImage<AtlasImageType>(atlasImageFilename);
+  inputs.AtlasBrainMask = ReadImage<AtlasLabelType>(atlasMaskFilename);
+  return inputs;
+}
+
+// atlas prepared once for all filters of type TFilter
+template <typename TFilter>
+typename TFilter::PreparedAtlasType::Pointer
+PrepareAtlas(const Inputs & inputs)
+{
+  typename TFilter::PreparedAtlasType::Pointer preparedAtlas = TFilter::PreparedAtlasType::New();
+  preparedAtlas->SetAtlasImage(inputs.AtlasImage);
+  preparedAtlas->SetAtlasBrainMask(inputs.AtlasBrainMask);
+  preparedAtlas->Prepare();
+  return preparedAtlas;
+}
+
+// filter on the patient image, configured by the test before Update()
+template <typename TFilter>
+typename TFilter::Pointer
+CreateFilter(const Inputs & inputs, typename TFilter::PreparedAtlasType * preparedAtlas)
+{
+  typename TFilter::Pointer filter = TFilter::New();
+  filter->SetInput(inputs.PatientImage);
+  filter->SetPreparedAtlas(preparedAtlas);
+  return filter;
+}
+
+// Dice coefficient of the brain voxels of two masks on the same grid, NaN if both are empty
+inline double
+DiceCoefficient(const AtlasLabelType * mask, const AtlasLabelType * reference)
+{
+  using OverlapFilterType = itk::LabelOverlapMeasuresImageFilter<AtlasLabelType>;
+  OverlapFilterType::Pointer overlap = OverlapFilterType::New();
+  overlap->SetSourceImage(mask);
+  overlap->SetTargetImage(reference);
+  overlap->Update();
+  return overlap->GetDiceCoefficient();
+}
+
+// prints the Dice coefficient of both masks, false if it is below minimumDice
+inline bool
+MasksAgree(const AtlasLabelType * mask, const AtlasLabelType * reference, const std::string & label, double minimumDice)
+{
+  const double dice = DiceCoefficient(mask, reference);
+  std::cout << "Dice " << label << ": " << dice << std::endl;
+
+  // written so that NaN fails as well
+  if (!(dice >= minimumDice))
+  {
+    std::cerr << "Test failed!" << std::endl;
+    std::cerr << "Dice coefficient " << dice << " below " << minimumDice << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // end namespace StripTsTest
+
+#endif